@@ -0,0 +1,436 @@
+/*******************************************************************************
+ * Copyright (C) 2017 Maxim Integrated Products, Inc., All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL MAXIM INTEGRATED BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Except as contained in this notice, the name of Maxim Integrated
+ * Products, Inc. shall not be used except as stated in the Maxim Integrated
+ * Products, Inc. Branding Policy.
+ *
+ * The mere transfer of this software does not imply any licenses
+ * of trade secrets, proprietary technology, copyrights, patents,
+ * trademarks, maskwork rights, or any other form of intellectual
+ * property whatsoever. Maxim Integrated Products, Inc. retains all
+ * ownership rights.
+ *
+ ******************************************************************************/
+
+
+#include "global.h"
+#include "autotune.h"
+
+// Background tuning of the receive path.  Adjustments are computed as results are
+// processed and written to the TDC by autotune_apply() between measurements so a
+// measurement in flight never sees a register change.
+
+// Comparator threshold tracking.  The T1 threshold (C_OFFSETUP/C_OFFSETDN) is nudged
+// to keep the T1/T2 wave width ratio in a window around 0.5.  A ratio that is too small means
+// the threshold is close to the peak of the first wave and will start missing it as the
+// signal weakens; too large means it is close to the noise floor.  Results whose T2/ideal
+// ratio is outside its window did not lock onto a clean wave and are ignored.
+// Ratios are 1/128 units, as held in the WVRUP/WVRDN registers.
+// The offsets are signed:  a negative offset detects the negative going edge.  Tracking moves
+// the magnitude and never crosses zero, which would change the edge being detected.
+
+#define T1_T2_MIN		51		// 0.4
+#define T1_T2_MAX		77		// 0.6
+#define T2_IDEAL_MIN	96		// 0.75
+#define T2_IDEAL_MAX	160		// 1.25
+#define THRESHOLD_MIN	1		// magnitude
+#define THRESHOLD_MAX	127
+#define TIMEOUT_STEP	4
+
+// Automatic gain control (MAX35104 only).  With the threshold fixed, the T1/T2 ratio grows
+// with the received amplitude.  The PGA gain is stepped when the ratio stays outside a band
+// wider than the threshold tracking window for AGC_HOLD consecutive results, so the two loops
+// don't fight:  the threshold trims within the band and the gain handles the large swings.
+
+#define AGC_T1_T2_LOW	38		// 0.3
+#define AGC_T1_T2_HIGH	90		// 0.7
+#define AGC_HOLD		4
+#define AGC_STEP		4		// PGA codes
+
+// Receive window tracking.  DLY is placed ahead of the onset of the received burst, estimated
+// from the first hit and its wave number, and TIMOUT is the smallest setting that covers the
+// last hit with margin.  Moving out is immediate.  Moving in needs WINDOW_HOLD consecutive
+// results that fit, and DLY only moves when it's off by more than DLY_HYSTERESIS, so jitter in
+// the flight time doesn't cause register churn.  A timeout widens both sides.
+
+#define DLY_MARGIN			0.85f	// DLY as a fraction of the burst onset
+#define DLY_HYSTERESIS		0.05f
+#define TIMOUT_MARGIN		1.25f	// TIMOUT as a multiple of the last hit
+#define TIMOUT_MARGIN_US	16.0f
+#define TIMOUT_US(r)		(128.0f*(float_t)(1<<(r)))
+#define WINDOW_HOLD			16
+
+typedef struct _window_t
+{
+	uint16_t	dly;
+	uint16_t	dly_written;
+	uint8_t		timout;
+	uint8_t		timout_written;
+	uint8_t		hold;
+}
+window_t;
+
+typedef struct _threshold_t
+{
+	int16_t	value;
+	int16_t	written;
+	bool	negative;	// C_OFFSETUP/C_OFFSETDN polarity
+}
+threshold_t;
+
+static bool			s_threshold_enabled;
+static threshold_t	s_threshold_up;
+static threshold_t	s_threshold_dn;
+
+static bool			s_window_enabled;
+static window_t		s_window;
+
+#ifdef MAX35104
+static autotune_agc_mode_t	s_agc_mode;
+static threshold_t			s_gain;
+static int8_t				s_agc_count;		// signed run of out of band results
+static uint16_t				s_interleave_gain[2];
+static uint8_t				s_gain_slot;		// interleave gain used by the measurement in flight
+static bool					s_gain_used;		// a TOF has completed at the current slot's gain
+#endif
+
+static void threshold_clamp( threshold_t *p_threshold )
+{
+	// within the int8 register range on the side of zero the offset started on
+	int16_t min = p_threshold->negative ? INT8_MIN : THRESHOLD_MIN;
+	int16_t max = p_threshold->negative ? -THRESHOLD_MIN : THRESHOLD_MAX;
+	if( p_threshold->value < min )
+		p_threshold->value = min;
+	else if( p_threshold->value > max )
+		p_threshold->value = max;
+}
+
+static void threshold_step( threshold_t *p_threshold, int16_t step )
+{
+	// positive steps raise the magnitude
+	p_threshold->value += p_threshold->negative ? -step : step;
+	threshold_clamp( p_threshold );
+}
+
+static void threshold_read( threshold_t *p_threshold, int8_t value )
+{
+	p_threshold->value = p_threshold->written = value;
+	p_threshold->negative = value < 0;
+}
+
+static void threshold_track( threshold_t *p_threshold, const max3510x_measurement_t *p_measurement )
+{
+	uint16_t t1_t2 = MAX3510X_ENDIAN( p_measurement->t1_t2 );
+	uint16_t t2_ideal = MAX3510X_ENDIAN( p_measurement->t2_ideal );
+
+	if( t2_ideal < T2_IDEAL_MIN || t2_ideal > T2_IDEAL_MAX )
+		return;
+	if( t1_t2 < T1_T2_MIN )
+		threshold_step( p_threshold, -1 );
+	else if( t1_t2 > T1_T2_MAX )
+		threshold_step( p_threshold, 1 );
+}
+
+#ifdef MAX35104
+
+static void gain_clamp( void )
+{
+	if( s_gain.value < MAX3510X_REG_AFE2_PGA_DB_MIN )
+		s_gain.value = MAX3510X_REG_AFE2_PGA_DB_MIN;
+	else if( s_gain.value > MAX3510X_REG_AFE2_PGA_DB_MAX )
+		s_gain.value = MAX3510X_REG_AFE2_PGA_DB_MAX;
+}
+
+static bool agc_ratio( const max3510x_measurement_t *p_measurement, uint16_t *p_t1_t2 )
+{
+	uint16_t t2_ideal = MAX3510X_ENDIAN( p_measurement->t2_ideal );
+	if( t2_ideal < T2_IDEAL_MIN || t2_ideal > T2_IDEAL_MAX )
+		return false;
+	*p_t1_t2 = MAX3510X_ENDIAN( p_measurement->t1_t2 );
+	return true;
+}
+
+void autotune_agc( const max3510x_tof_results_t *p_results, bool up, bool down )
+{
+	// both directions share the PGA, so step on the weaker of the two
+	uint16_t t1_t2 = 0xFFFF, t;
+	if( s_agc_mode != autotune_agc_mode_on )
+		return;
+	if( up && agc_ratio( &p_results->up, &t ) && t < t1_t2 )
+		t1_t2 = t;
+	if( down && agc_ratio( &p_results->down, &t ) && t < t1_t2 )
+		t1_t2 = t;
+	if( t1_t2 == 0xFFFF )
+		return;
+	if( t1_t2 < AGC_T1_T2_LOW )
+	{
+		if( s_agc_count < 0 )
+			s_agc_count = 0;
+		if( ++s_agc_count >= AGC_HOLD )
+		{
+			s_gain.value += AGC_STEP;
+			s_agc_count = 0;
+		}
+	}
+	else if( t1_t2 > AGC_T1_T2_HIGH )
+	{
+		if( s_agc_count > 0 )
+			s_agc_count = 0;
+		if( --s_agc_count <= -AGC_HOLD )
+		{
+			s_gain.value -= AGC_STEP;
+			s_agc_count = 0;
+		}
+	}
+	else
+	{
+		s_agc_count = 0;
+	}
+	gain_clamp();
+}
+
+void autotune_set_agc_mode( autotune_agc_mode_t mode )
+{
+	if( mode != s_agc_mode )
+	{
+		// pick up any manual pga changes
+		s_gain.value = s_gain.written = MAX3510X_READ_BITFIELD( NULL, AFE2, PGA );
+		s_agc_count = 0;
+		s_gain_slot = 0;
+		s_gain_used = false;
+	}
+	s_agc_mode = mode;
+}
+
+autotune_agc_mode_t autotune_get_agc_mode( void )
+{
+	return s_agc_mode;
+}
+
+void autotune_set_interleave_gains( uint16_t gain_a, uint16_t gain_b )
+{
+	s_interleave_gain[0] = gain_a;
+	s_interleave_gain[1] = gain_b;
+}
+
+void autotune_get_interleave_gains( uint16_t *p_gain_a, uint16_t *p_gain_b )
+{
+	*p_gain_a = s_interleave_gain[0];
+	*p_gain_b = s_interleave_gain[1];
+}
+
+uint8_t autotune_gain_slot( void )
+{
+	// which interleave gain the most recent measurement used
+	return s_gain_slot;
+}
+
+void autotune_tof_complete( void )
+{
+	// a TOF result came back, so the next TOF may move to the other interleave gain.  a
+	// timeout doesn't count:  its retry runs at the same gain.
+	s_gain_used = true;
+}
+
+#endif
+
+void autotune_init( void )
+{
+	// start from whatever is in the TDC now, including manual c_offsetup/c_offsetdn changes
+	threshold_read( &s_threshold_up, (int8_t)MAX3510X_READ_BITFIELD( NULL, TOF6, C_OFFSETUP ) );
+	threshold_read( &s_threshold_dn, (int8_t)MAX3510X_READ_BITFIELD( NULL, TOF7, C_OFFSETDN ) );
+	s_window.dly = s_window.dly_written = MAX3510X_READ_BITFIELD( NULL, TOF_MEASUREMENT_DELAY, DLY );
+	s_window.timout = s_window.timout_written = MAX3510X_READ_BITFIELD( NULL, TOF2, TIMOUT );
+	s_window.hold = 0;
+#ifdef MAX35104
+	s_gain.value = s_gain.written = MAX3510X_READ_BITFIELD( NULL, AFE2, PGA );
+	s_agc_count = 0;
+#endif
+}
+
+void autotune_threshold_enable( bool enable )
+{
+	if( enable && !s_threshold_enabled )
+		autotune_init();
+	s_threshold_enabled = enable;
+}
+
+bool autotune_threshold_enabled( void )
+{
+	return s_threshold_enabled;
+}
+
+void autotune_threshold( const max3510x_tof_results_t *p_results, bool up, bool down )
+{
+	if( !s_threshold_enabled )
+		return;
+	if( up )
+		threshold_track( &s_threshold_up, &p_results->up );
+	if( down )
+		threshold_track( &s_threshold_dn, &p_results->down );
+}
+
+static uint16_t dly_limit( float_t dly_us )
+{
+	int32_t r = (int32_t)MAX3510X_REG_TOF_MEASUREMENT_DELAY_DLY_US( dly_us );
+	if( r < MAX3510X_REG_TOF_MEASUREMENT_DELAY_DLY_MIN )
+		r = MAX3510X_REG_TOF_MEASUREMENT_DELAY_DLY_MIN;
+	else if( r > MAX3510X_REG_TOF_MEASUREMENT_DELAY_DLY_MAX )
+		r = MAX3510X_REG_TOF_MEASUREMENT_DELAY_DLY_MAX;
+	return (uint16_t)r;
+}
+
+void autotune_window_enable( bool enable )
+{
+	if( enable && !s_window_enabled )
+		autotune_init();
+	s_window_enabled = enable;
+}
+
+bool autotune_window_enabled( void )
+{
+	return s_window_enabled;
+}
+
+void autotune_window( const fixed_tof_t *p_tof, const uint8_t *p_hitwaves, uint8_t hitcount )
+{
+	fixed_t first, last, period;
+	float_t onset_us, last_us, dly_us;
+	uint8_t timout;
+	int16_t waves;
+
+	if( !s_window_enabled || hitcount < 2 || hitcount > MAX3510X_MAX_HITCOUNT )
+		return;
+	waves = (int16_t)p_hitwaves[hitcount-1] - (int16_t)p_hitwaves[0];
+	if( waves <= 0 )
+		return;
+
+	// earliest first hit and latest last hit over both directions
+	first = p_tof->up.hit[0] < p_tof->down.hit[0] ? p_tof->up.hit[0] : p_tof->down.hit[0];
+	last = p_tof->up.hit[hitcount-1] > p_tof->down.hit[hitcount-1] ? p_tof->up.hit[hitcount-1] : p_tof->down.hit[hitcount-1];
+	period = (p_tof->up.hit[hitcount-1] - p_tof->up.hit[0]) / waves;
+	onset_us = fixed_to_float( first - period * (fixed_t)p_hitwaves[0] ) * 1e6f;
+	last_us = fixed_to_float( last ) * 1e6f;
+	if( onset_us <= 0 )
+		return;
+
+	for( timout = 0; timout < MAX3510X_REG_TOF2_TIMOUT_16384US && TIMOUT_US(timout) < last_us * TIMOUT_MARGIN + TIMOUT_MARGIN_US; timout++ );
+	dly_us = onset_us * DLY_MARGIN;
+
+	if( timout > s_window.timout || dly_us < MAX3510X_REG_TOF_MEASUREMENT_DELAY_DLY(s_window.dly) )
+	{
+		// the burst is outside the window.  open it up now.
+		if( timout > s_window.timout )
+			s_window.timout = timout;
+		if( dly_us < MAX3510X_REG_TOF_MEASUREMENT_DELAY_DLY(s_window.dly) )
+			s_window.dly = dly_limit( dly_us );
+		s_window.hold = 0;
+	}
+	else if( timout < s_window.timout || dly_us > MAX3510X_REG_TOF_MEASUREMENT_DELAY_DLY(s_window.dly) * (1.0f + DLY_HYSTERESIS) )
+	{
+		if( ++s_window.hold >= WINDOW_HOLD )
+		{
+			s_window.hold = 0;
+			if( timout < s_window.timout )
+				s_window.timout--;
+			if( dly_us > MAX3510X_REG_TOF_MEASUREMENT_DELAY_DLY(s_window.dly) * (1.0f + DLY_HYSTERESIS) )
+				s_window.dly = dly_limit( dly_us );
+		}
+	}
+	else
+	{
+		s_window.hold = 0;
+	}
+}
+
+void autotune_timeout( void )
+{
+	// the first wave never crossed the threshold in at least one direction
+	if( s_window_enabled )
+	{
+		if( s_window.timout < MAX3510X_REG_TOF2_TIMOUT_16384US )
+			s_window.timout++;
+		s_window.dly = dly_limit( MAX3510X_REG_TOF_MEASUREMENT_DELAY_DLY(s_window.dly) * DLY_MARGIN );
+		s_window.hold = 0;
+	}
+#ifdef MAX35104
+	if( s_agc_mode == autotune_agc_mode_on )
+	{
+		s_gain.value += AGC_STEP;
+		s_agc_count = 0;
+		gain_clamp();
+	}
+#endif
+	if( !s_threshold_enabled )
+		return;
+	threshold_step( &s_threshold_up, -TIMEOUT_STEP );
+	threshold_step( &s_threshold_dn, -TIMEOUT_STEP );
+}
+
+void autotune_apply( bool tof )
+{
+	// only touch the registers that changed.  tof is true when the next command is a TOF.
+	if( s_window_enabled )
+	{
+		if( s_window.dly != s_window.dly_written )
+		{
+			MAX3510X_WRITE_BITFIELD( NULL, TOF_MEASUREMENT_DELAY, DLY, s_window.dly );
+			s_window.dly_written = s_window.dly;
+		}
+		if( s_window.timout != s_window.timout_written )
+		{
+			MAX3510X_WRITE_BITFIELD( NULL, TOF2, TIMOUT, s_window.timout );
+			s_window.timout_written = s_window.timout;
+		}
+	}
+#ifdef MAX35104
+	if( s_agc_mode == autotune_agc_mode_interleave )
+	{
+		// temperature and calibration measurements in between don't use the PGA, so they
+		// mustn't take a turn, or a diff,temp sequence would put every TOF at one gain
+		if( tof && s_gain_used )
+		{
+			s_gain_slot ^= 1;
+			s_gain_used = false;
+		}
+		s_gain.value = s_interleave_gain[s_gain_slot];
+		gain_clamp();
+	}
+	if( s_agc_mode != autotune_agc_mode_off && s_gain.value != s_gain.written )
+	{
+		MAX3510X_WRITE_BITFIELD( NULL, AFE2, PGA, s_gain.value );
+		s_gain.written = s_gain.value;
+	}
+#endif
+	if( !s_threshold_enabled )
+		return;
+	if( s_threshold_up.value != s_threshold_up.written )
+	{
+		MAX3510X_WRITE_BITFIELD( NULL, TOF6, C_OFFSETUP, (int8_t)s_threshold_up.value );
+		s_threshold_up.written = s_threshold_up.value;
+	}
+	if( s_threshold_dn.value != s_threshold_dn.written )
+	{
+		MAX3510X_WRITE_BITFIELD( NULL, TOF7, C_OFFSETDN, (int8_t)s_threshold_dn.value );
+		s_threshold_dn.written = s_threshold_dn.value;
+	}
+}
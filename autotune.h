@@ -0,0 +1,70 @@
+/*******************************************************************************
+ * Copyright (C) 2017 Maxim Integrated Products, Inc., All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL MAXIM INTEGRATED BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Except as contained in this notice, the name of Maxim Integrated
+ * Products, Inc. shall not be used except as stated in the Maxim Integrated
+ * Products, Inc. Branding Policy.
+ *
+ * The mere transfer of this software does not imply any licenses
+ * of trade secrets, proprietary technology, copyrights, patents,
+ * trademarks, maskwork rights, or any other form of intellectual
+ * property whatsoever. Maxim Integrated Products, Inc. retains all
+ * ownership rights.
+ *
+ ******************************************************************************/
+
+
+#ifndef __AUTOTUNE_H__
+#define __AUTOTUNE_H__
+
+#include "fixed.h"
+
+void autotune_init( void );
+void autotune_threshold_enable( bool enable );
+bool autotune_threshold_enabled( void );
+void autotune_threshold( const max3510x_tof_results_t *p_results, bool up, bool down );
+void autotune_window_enable( bool enable );
+bool autotune_window_enabled( void );
+void autotune_window( const fixed_tof_t *p_tof, const uint8_t *p_hitwaves, uint8_t hitcount );
+void autotune_timeout( void );
+void autotune_apply( bool tof );
+
+#ifdef MAX35104
+
+typedef enum _autotune_agc_mode_t
+{
+	autotune_agc_mode_off,
+	autotune_agc_mode_on,
+	autotune_agc_mode_interleave	// alternate between two fixed gains for characterization
+}
+autotune_agc_mode_t;
+
+void autotune_agc( const max3510x_tof_results_t *p_results, bool up, bool down );
+void autotune_set_agc_mode( autotune_agc_mode_t mode );
+autotune_agc_mode_t autotune_get_agc_mode( void );
+void autotune_set_interleave_gains( uint16_t gain_a, uint16_t gain_b );
+void autotune_get_interleave_gains( uint16_t *p_gain_a, uint16_t *p_gain_b );
+uint8_t autotune_gain_slot( void );
+void autotune_tof_complete( void );
+
+#endif
+
+#endif
@@ -0,0 +1,123 @@
+/*******************************************************************************
+ * Copyright (C) 2017 Maxim Integrated Products, Inc., All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL MAXIM INTEGRATED BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Except as contained in this notice, the name of Maxim Integrated
+ * Products, Inc. shall not be used except as stated in the Maxim Integrated
+ * Products, Inc. Branding Policy.
+ *
+ * The mere transfer of this software does not imply any licenses
+ * of trade secrets, proprietary technology, copyrights, patents,
+ * trademarks, maskwork rights, or any other form of intellectual
+ * property whatsoever. Maxim Integrated Products, Inc. retains all
+ * ownership rights.
+ *
+ ******************************************************************************/
+
+
+#include "global.h"
+#include "calibration.h"
+#include "board.h"
+
+// Caches the 4MHz reference calibration so the TDC only has to be calibrated when
+// the reference is likely to have drifted:  when the temperature has moved by more than
+// the drift threshold or the calibration has aged past the interval.
+
+#define SCALE_SHIFT	30
+
+static bool		s_valid;
+static uint32_t	s_frequency;
+static float_t	s_factor;
+static int32_t	s_scale;			// s_factor as Q2.30
+static uint32_t	s_timestamp;		// time of the last calibration
+static float_t	s_temp_K;			// temperature at the last calibration
+static float_t	s_interval = 60.0f;
+static float_t	s_drift = 2.0f;
+
+bool calibration_due( float_t temp_K )
+{
+	float_t elapsed;
+	float_t delta;
+	if( !s_valid )
+		return true;
+	board_elapsed_time( s_timestamp, &elapsed );
+	if( s_interval > 0 && elapsed >= s_interval )
+		return true;
+	delta = temp_K - s_temp_K;
+	if( s_drift > 0 && temp_K > 0 && (delta >= s_drift || delta <= -s_drift) )
+		return true;
+	return false;
+}
+
+void calibration_update( const max3510x_fixed_t *p_cal, float_t temp_K )
+{
+	s_frequency = max3510x_input_frequency( p_cal );
+	s_factor = max3510x_calibration_factor( s_frequency );
+	s_scale = (int32_t)( s_factor * (float_t)(1UL<<SCALE_SHIFT) + 0.5f );
+	s_timestamp = board_timestamp();
+	s_temp_K = temp_K;
+	s_valid = true;
+}
+
+void calibration_invalidate( void )
+{
+	s_valid = false;
+}
+
+bool calibration_valid( void )
+{
+	return s_valid;
+}
+
+int32_t calibration_scale( void )
+{
+	// Q2.30 multiplier for TDC times.  unity until the first calibration completes.
+	return s_valid ? s_scale : (int32_t)(1UL<<SCALE_SHIFT);
+}
+
+float_t calibration_get_factor( void )
+{
+	return s_factor;
+}
+
+uint32_t calibration_get_frequency( void )
+{
+	return s_frequency;
+}
+
+void calibration_set_interval( float_t seconds )
+{
+	s_interval = seconds;
+}
+
+float_t calibration_get_interval( void )
+{
+	return s_interval;
+}
+
+void calibration_set_drift( float_t kelvin )
+{
+	s_drift = kelvin;
+}
+
+float_t calibration_get_drift( void )
+{
+	return s_drift;
+}
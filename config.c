@@ -37,6 +37,15 @@
 #include "board.h"
 #include "flow.h"
 #include "transducer.h"
+#include "flowbody.h"
+#include "temperature.h"
+#include "calibration.h"
+#include "autotune.h"
+#include "fusion.h"
+#include "zero.h"
+#include "recovery.h"
+#include "filter.h"
+#include "hampel.h"
 
 #pragma pack(1)
 
@@ -54,7 +63,35 @@ typedef struct _data_t
 	float_t 						sampling_frequency;
 	int16_t							tof_temp;
 	max3510x_event_timing_mode_t	event_timing_mode;
-	max3510x_registers_t			chip_config;
+	float_t							area;
+	temperature_sensor_t			temperature_sensor;
+	uint8_t							sequence_count;
+	flow_seq_slot_t					sequence[FLOW_SEQ_MAX_SLOTS];
+	float_t							cal_interval;
+	float_t							cal_drift;
+	bool							autotune_threshold;
+	bool							autotune_window;
+	float_t							path_weight[FLOW_INSTANCE_COUNT];
+	float_t							path_length[FLOW_INSTANCE_COUNT];
+	float_t							path_angle[FLOW_INSTANCE_COUNT];
+	uint8_t							path_mask;
+	bool							zero_learn;
+	float_t							zero_band;
+	float_t							zero_noise;
+	float_t							zero_seed;
+	fixed_t							zero_offset[FLOW_INSTANCE_COUNT];
+	uint8_t							recovery_budget;
+	uint8_t							recovery_options;
+	filter_type_t					filter_type;
+	uint8_t							filter_order;
+	float_t							filter_cutoff;
+	uint8_t							hampel_window;
+	float_t							hampel_threshold;
+#ifdef MAX35104
+	autotune_agc_mode_t				agc_mode;
+	uint16_t						agc_gain[2];
+#endif
+	max3510x_registers_t			chip_config[FLOW_INSTANCE_COUNT];
 }
 data_t;
 
@@ -75,12 +112,42 @@ static config_t s_config;
 
 void config_save( void )
 {
+	uint8_t i;
 	s_config.header.size = sizeof(s_config.pad);
 	s_config.data.flow_sampling_mode = flow_get_sampling_mode();
 	s_config.data.flow_sos_method = flow_get_sos_method();
 	s_config.data.sampling_frequency = flow_get_sampling_frequency();
 	s_config.data.tof_temp = flow_get_tof_temp();
 	s_config.data.event_timing_mode = flow_get_event_timing_mode();
+	s_config.data.area = flowbody_get_area();
+	s_config.data.temperature_sensor = temperature_get_sensor();
+	s_config.data.sequence_count = flow_get_sequence( s_config.data.sequence );
+	s_config.data.cal_interval = calibration_get_interval();
+	s_config.data.cal_drift = calibration_get_drift();
+	s_config.data.autotune_threshold = autotune_threshold_enabled();
+	s_config.data.autotune_window = autotune_window_enabled();
+	fusion_get_weights( s_config.data.path_weight );
+	for( i = 0; i < FLOW_INSTANCE_COUNT; i++ )
+	{
+		s_config.data.path_length[i] = flowbody_get_path_length( i );
+		s_config.data.path_angle[i] = flowbody_get_path_angle( i );
+	}
+	s_config.data.path_mask = fusion_get_mask();
+	s_config.data.zero_learn = zero_enabled();
+	zero_get_limits( &s_config.data.zero_band, &s_config.data.zero_noise, &s_config.data.zero_seed );
+	for( i = 0; i < FLOW_INSTANCE_COUNT; i++ )
+		s_config.data.zero_offset[i] = zero_get_offset( i );
+	s_config.data.recovery_budget = recovery_get_budget();
+	s_config.data.recovery_options = recovery_get_options();
+	s_config.data.filter_type = filter_get_type();
+	s_config.data.filter_order = filter_get_order();
+	s_config.data.filter_cutoff = filter_get_cutoff();
+	s_config.data.hampel_window = hampel_get_window();
+	s_config.data.hampel_threshold = hampel_get_threshold();
+#ifdef MAX35104
+	s_config.data.agc_mode = autotune_get_agc_mode();
+	autotune_get_interleave_gains( &s_config.data.agc_gain[0], &s_config.data.agc_gain[1] );
+#endif
 	uint16_t crc = board_crc( &s_config.pad, sizeof(s_config.pad) );
 
 	s_config.header.crc = crc;
@@ -89,23 +156,77 @@ void config_save( void )
 
 static void apply( void )
 {
+	uint8_t i;
 	flow_set_sampling_mode( s_config.data.flow_sampling_mode );
 	flow_set_sampling_frequency( s_config.data.sampling_frequency );
 	flow_set_sos_method( s_config.data.flow_sos_method );
 	flow_set_tof_temp( s_config.data.tof_temp );
 	flow_set_event_timing_mode( s_config.data.event_timing_mode );
+	flowbody_set_area( s_config.data.area );
+	temperature_set_sensor( s_config.data.temperature_sensor );
+	if( !flow_set_sequence( s_config.data.sequence, s_config.data.sequence_count ) )
+		flow_set_sequence( NULL, 0 );
+	calibration_set_interval( s_config.data.cal_interval );
+	calibration_set_drift( s_config.data.cal_drift );
+	autotune_threshold_enable( s_config.data.autotune_threshold );
+	autotune_window_enable( s_config.data.autotune_window );
+	fusion_set_weights( s_config.data.path_weight, FLOW_INSTANCE_COUNT );
+	for( i = 0; i < FLOW_INSTANCE_COUNT; i++ )
+	{
+		flowbody_set_path_length( i, s_config.data.path_length[i] );
+		flowbody_set_path_angle( i, s_config.data.path_angle[i] );
+	}
+	fusion_set_mask( s_config.data.path_mask );
+	zero_set_limits( s_config.data.zero_band, s_config.data.zero_noise, s_config.data.zero_seed );
+	for( i = 0; i < FLOW_INSTANCE_COUNT; i++ )
+		zero_set_offset( i, s_config.data.zero_offset[i] );
+	zero_enable( s_config.data.zero_learn );
+	recovery_set_budget( s_config.data.recovery_budget );
+	recovery_set_options( s_config.data.recovery_options );
+	filter_set_design( s_config.data.filter_type, s_config.data.filter_order, s_config.data.filter_cutoff );
+	hampel_set_window( s_config.data.hampel_window, s_config.data.hampel_threshold );
+#ifdef MAX35104
+	autotune_set_interleave_gains( s_config.data.agc_gain[0], s_config.data.agc_gain[1] );
+	autotune_set_agc_mode( s_config.data.agc_mode );
+#endif
 }
 
 void config_default( void )
 {
     memset( &s_config, 0, sizeof(s_config) );
 	const max3510x_registers_t *p_default = transducer_config();
-	memcpy( &s_config.data.chip_config, p_default, sizeof(s_config.data.chip_config) );
+	uint8_t i;
+	for( i = 0; i < FLOW_INSTANCE_COUNT; i++ )
+		memcpy( &s_config.data.chip_config[i], p_default, sizeof(s_config.data.chip_config[i]) );
 	s_config.data.flow_sampling_mode = flow_sampling_mode_idle;
 	s_config.data.flow_sos_method = flow_sos_method_direct;
 	s_config.data.sampling_frequency = 20.0f;
 	s_config.data.tof_temp = 1;
 	s_config.data.event_timing_mode = max3510x_event_timing_mode_tof;
+	s_config.data.area = 3.1416e-4f;		// 20mm bore
+	s_config.data.temperature_sensor = temperature_sensor_pt1000;
+	s_config.data.cal_interval = 60.0f;
+	s_config.data.cal_drift = 2.0f;
+	for( i = 0; i < FLOW_INSTANCE_COUNT; i++ )
+	{
+		s_config.data.path_weight[i] = 1.0f / (float_t)FLOW_INSTANCE_COUNT;	// Gauss-Jacobi for one or two paths
+		s_config.data.path_length[i] = 0.1f;		// 100mm axial path
+		s_config.data.path_angle[i] = 0.0f;
+	}
+	s_config.data.path_mask = (uint8_t)((1UL<<FLOW_INSTANCE_COUNT)-1);
+	s_config.data.zero_band = 1e-9f;
+	s_config.data.zero_noise = 50e-12f;
+	s_config.data.zero_seed = 10e-9f;
+	s_config.data.recovery_budget = 2;
+	s_config.data.filter_type = filter_type_butterworth;
+	s_config.data.filter_order = 4;
+	s_config.data.filter_cutoff = 1.0f;
+	s_config.data.hampel_window = 7;
+	s_config.data.hampel_threshold = 3.0f;
+#ifdef MAX35104
+	s_config.data.agc_gain[0] = (uint16_t)MAX3510X_REG_AFE2_PGA_DB(14.0f);
+	s_config.data.agc_gain[1] = (uint16_t)MAX3510X_REG_AFE2_PGA_DB(18.0f);
+#endif
 	apply();
 	config_save();
 }
@@ -127,7 +248,9 @@ void config_load( void )
 	config_default();
 }
 
-max3510x_registers_t* config_get_max3510x_regs( void )
+max3510x_registers_t* config_get_max3510x_regs( uint8_t ndx )
 {
-	return &s_config.data.chip_config;
+	if( ndx >= FLOW_INSTANCE_COUNT )
+		return NULL;
+	return &s_config.data.chip_config[ndx];
 }
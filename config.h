@@ -39,6 +39,6 @@
 void config_save( void );
 void config_load(void);
 void config_default(void);
-max3510x_registers_t * config_get_max3510x_regs(void);
+max3510x_registers_t * config_get_max3510x_regs( uint8_t ndx );
 
 #endif
@@ -2,24 +2,466 @@
 #include "filter.h"
 #include <arm_math.h>
 
-void filter_init( filter_t *p_filter )
+// Lowpass biquad cascade.  The cascade is far cheaper per sample when it's given
+// a block:  the coefficients and state stay in registers across the block instead of being
+// reloaded for every sample.  Samples are queued with filter_push() and run through the
+// cascade together by filter_flush(), or when the block fills.  filter_sample() filters a
+// single sample immediately for callers that can't wait.
+
+// Coefficients are designed at runtime from the analog prototype poles by the bilinear
+// transform, prewarped so the -3dB point lands on the cutoff at the current sampling rate.
+// Designs are cached by rate, so moving between sampling rates and modes that have been
+// seen before costs no trig.  Changing the design empties the cache.
+
+#define CACHE_SIZE		4
+#define NYQUIST_LIMIT	0.45f	// highest cutoff as a fraction of the sampling rate
+#define DEFAULT_RATE	20.0f	// Hz, for an init without a usable rate
+#define Q31_POST_SHIFT	1
+#define Q31_SCALE		(float_t)(1UL<<(31-Q31_POST_SHIFT))
+#define Q31_LIMIT		((q31_t)1<<(30-FILTER_Q31_GUARD))	// largest input magnitude
+
+#define BANK_RECENTRE	(1L<<23)	// largest offset from the origin before it's moved
+
+#ifdef FILTER_Q31_FAST
+#define biquad_q31	arm_biquad_cascade_df1_fast_q31
+#else
+#define biquad_q31	arm_biquad_cascade_df1_q31
+#endif
+
+typedef struct _design_t
+{
+	float_t	rate;
+	uint8_t	stages;
+	float_t	coef[5*FILTER_STAGES];
+}
+design_t;
+
+// Bessel poles normalized for -3dB at 1 rad/s:  real part, imaginary part.
+// One entry per conjugate pair, with the real pole of the odd orders last.
+
+static const float_t s_bessel[FILTER_MAX_ORDER][FILTER_STAGES][2] =
+{
+	{ { -1.0000f, 0.0f } },
+	{ { -1.1016f, 0.6360f } },
+	{ { -1.0474f, 0.9992f }, { -1.3226f, 0.0f } },
+	{ { -0.9952f, 1.2571f }, { -1.3700f, 0.4102f } }
+};
+
+static filter_type_t	s_type = filter_type_butterworth;
+static uint8_t			s_order = FILTER_MAX_ORDER;
+static float_t			s_cutoff = 1.0f;		// Hz
+static uint8_t			s_design = 1;			// generation, bumped by every design change
+static design_t			s_cache[CACHE_SIZE];
+static uint8_t			s_cache_next;
+
+static void section( float_t *p_coef, float_t re, float_t im, float_t k )
+{
+	// one analog section, normalized to a 1 rad/s cutoff and mapped with s = (1/k)(1-z^-1)/(1+z^-1).
+	// CMSIS wants the feedback coefficients negated:  y = b0x0 + b1x1 + b2x2 + a1y1 + a2y2
+	float_t d0;
+	if( im == 0.0f )
+	{
+		// H(s) = p/(s+p)
+		float_t p = -re * k;
+		d0 = 1.0f + p;
+		p_coef[0] = p / d0;
+		p_coef[1] = p_coef[0];
+		p_coef[2] = 0.0f;
+		p_coef[3] = ( 1.0f - p ) / d0;
+		p_coef[4] = 0.0f;
+	}
+	else
+	{
+		// H(s) = a0/(s^2 + a1s + a0)
+		float_t a1 = -2.0f * re * k;
+		float_t a0 = ( re*re + im*im ) * k * k;
+		d0 = 1.0f + a1 + a0;
+		p_coef[0] = a0 / d0;
+		p_coef[1] = 2.0f * p_coef[0];
+		p_coef[2] = p_coef[0];
+		p_coef[3] = ( 2.0f - 2.0f * a0 ) / d0;
+		p_coef[4] = -( 1.0f - a1 + a0 ) / d0;
+	}
+}
+
+static void design( design_t *p_design, float_t rate )
 {
-	static const float_t s_coef[10] = 
+	float_t cutoff = s_cutoff;
+	float_t k, re, im;
+	uint8_t i, pairs = s_order / 2;
+
+	if( cutoff > NYQUIST_LIMIT * rate )
+		cutoff = NYQUIST_LIMIT * rate;
+	k = tanf( PI * cutoff / rate );
+	p_design->rate = rate;
+	p_design->stages = ( s_order + 1 ) / 2;
+	for( i = 0; i < p_design->stages; i++ )
 	{
-		0.024886971908111608, 0.049773943816223215, 0.024886971908111608, 1.493723940028769, -0.562101135566579,
-		0.015625, 0.03125, 0.015625, 1.572224881546609, -0.6632163726145267
-	};
+		if( s_type == filter_type_bessel )
+		{
+			re = s_bessel[s_order-1][i][0];
+			im = s_bessel[s_order-1][i][1];
+		}
+		else if( i < pairs )
+		{
+			float_t theta = PI * (float_t)(2*i+1) / (float_t)(2*s_order);
+			re = -sinf( theta );
+			im = cosf( theta );
+		}
+		else
+		{
+			re = -1.0f;
+			im = 0.0f;
+		}
+		section( &p_design->coef[5*i], re, im, k );
+	}
+}
+
+static const design_t * lookup( float_t rate )
+{
+	uint8_t i;
+	design_t *p_design;
+	for( i = 0; i < CACHE_SIZE; i++ )
+	{
+		if( s_cache[i].rate == rate )
+			return &s_cache[i];
+	}
+	p_design = &s_cache[s_cache_next];
+	if( ++s_cache_next >= CACHE_SIZE )
+		s_cache_next = 0;
+	design( p_design, rate );
+	return p_design;
+}
+
+static void coef_q31( q31_t *p_q31, const float_t *p_coef, uint8_t stages )
+{
+	// rounding each coefficient on its own leaves a DC gain error that grows as the cutoff
+	// drops and the poles close on 1.  b1 takes up the difference so every section has a
+	// DC gain of exactly 1:  b0 + b1 + b2 = 1 - a1 - a2.
+	uint8_t i;
+	for( i = 0; i < 5*stages; i++ )
+		p_q31[i] = (q31_t)( p_coef[i] * Q31_SCALE + ( p_coef[i] < 0 ? -0.5f : 0.5f ) );
+	for( i = 0; i < stages; i++, p_q31 += 5 )
+		p_q31[1] = (q31_t)Q31_SCALE - p_q31[3] - p_q31[4] - p_q31[0] - p_q31[2];
+}
+
+void filter_init( filter_t *p_filter, float_t rate )
+{
+	// starts out designed for the expected rate, so the output is right before the first
+	// measured rate comes in
 	memset( p_filter, 0, sizeof( filter_t) );
-	arm_biquad_cascade_df1_init_f32( &p_filter->filter, 2, (float_t*)s_coef, p_filter->state );
+	filter_tune( p_filter, rate > 0 ? rate : DEFAULT_RATE );
+}
+
+bool filter_tune( filter_t *p_filter, float_t rate )
+{
+	// returns true if the coefficients changed
+	const design_t *p_design;
+	if( rate <= 0 || ( rate == p_filter->rate && p_filter->design == s_design ) )
+		return false;
+	filter_flush( p_filter );
+	p_design = lookup( rate );
+	memcpy( p_filter->coef, p_design->coef, p_design->stages * 5 * sizeof(float_t) );
+	if( p_design->stages != p_filter->filter.numStages )
+	{
+		// the state layout changes with the stage count, so start over from the last output
+		uint8_t i;
+		arm_biquad_cascade_df1_init_f32( &p_filter->filter, p_design->stages, p_filter->coef, p_filter->state );
+		for( i = 0; i < 4*p_design->stages; i++ )
+			p_filter->state[i] = p_filter->output;
+	}
+	p_filter->rate = rate;
+	p_filter->design = s_design;
+	return true;
 }
 
 float_t filter_sample( filter_t *p_filter, float_t sample )
 {
-	return sample;
-	/*
-	float_t output;
-	arm_biquad_cascade_df1_f32( &p_filter->filter, &sample, &output, 1 );
-	return output;
-	*/
+	// anything already queued comes first so the state stays in order
+	filter_flush( p_filter );
+	arm_biquad_cascade_df1_f32( &p_filter->filter, &sample, &p_filter->output, 1 );
+	return p_filter->output;
+}
+
+void filter_block( filter_t *p_filter, float_t *p_input, float_t *p_output, uint32_t count )
+{
+	// p_input and p_output may be the same buffer
+	if( !count )
+		return;
+	filter_flush( p_filter );
+	arm_biquad_cascade_df1_f32( &p_filter->filter, p_input, p_output, count );
+	p_filter->output = p_output[count-1];
+}
+
+bool filter_push( filter_t *p_filter, float_t sample )
+{
+	// returns true when the block filled and was filtered
+	p_filter->block[p_filter->count++] = sample;
+	if( p_filter->count < FILTER_BLOCK_SIZE )
+		return false;
+	filter_flush( p_filter );
+	return true;
+}
+
+uint8_t filter_flush( filter_t *p_filter )
+{
+	// filters the queued samples in place.  the results stay in block[] until the next push.
+	uint8_t count = p_filter->count;
+	if( count )
+	{
+		arm_biquad_cascade_df1_f32( &p_filter->filter, p_filter->block, p_filter->block, count );
+		p_filter->output = p_filter->block[count-1];
+		p_filter->count = 0;
+	}
+	return count;
+}
+
+// Q31 inputs are small integers such as a tof_diff of a few thousand counts.  Run through the
+// cascade as they are, every product is truncated to whole counts, which biases the output,
+// and the fast kernel keeps only the top 32 bits of each product, which leaves nothing.  So
+// inputs are shifted up by the guard bits on the way in, saturating at half of full scale to
+// leave headroom for overshoot, and rounded back down on the way out.  What's left is the
+// deadband of the truncating feedback, which grows with the square of rate/cutoff:  within
+// a couple of counts up to about 100, but the fast kernel only holds that to about 20.
+
+static q31_t q31_in( q31_t sample )
+{
+	if( sample > Q31_LIMIT )
+		sample = Q31_LIMIT;
+	else if( sample < -Q31_LIMIT )
+		sample = -Q31_LIMIT;
+	return sample << FILTER_Q31_GUARD;
+}
+
+static q31_t q31_out( q31_t sample )
+{
+	return (q31_t)( ( (q63_t)sample + ( 1L << (FILTER_Q31_GUARD-1) ) ) >> FILTER_Q31_GUARD );
+}
+
+void filter_q31_init( filter_q31_t *p_filter, float_t rate )
+{
+	memset( p_filter, 0, sizeof( filter_q31_t) );
+	filter_q31_tune( p_filter, rate > 0 ? rate : DEFAULT_RATE );
 }
 
+bool filter_q31_tune( filter_q31_t *p_filter, float_t rate )
+{
+	// shares the float design cache.  the conversion to Q31 is a multiply per coefficient.
+	const design_t *p_design;
+	if( rate <= 0 || ( rate == p_filter->rate && p_filter->design == s_design ) )
+		return false;
+	filter_q31_flush( p_filter );
+	p_design = lookup( rate );
+	coef_q31( p_filter->coef, p_design->coef, p_design->stages );
+	if( p_design->stages != p_filter->filter.numStages )
+	{
+		uint8_t i;
+		arm_biquad_cascade_df1_init_q31( &p_filter->filter, p_design->stages, p_filter->coef, p_filter->state, Q31_POST_SHIFT );
+		for( i = 0; i < 4*p_design->stages; i++ )
+			p_filter->state[i] = q31_in( p_filter->output );
+	}
+	p_filter->rate = rate;
+	p_filter->design = s_design;
+	return true;
+}
+
+q31_t filter_q31_sample( filter_q31_t *p_filter, q31_t sample )
+{
+	filter_q31_flush( p_filter );
+	sample = q31_in( sample );
+	biquad_q31( &p_filter->filter, &sample, &sample, 1 );
+	p_filter->output = q31_out( sample );
+	return p_filter->output;
+}
+
+void filter_q31_block( filter_q31_t *p_filter, q31_t *p_input, q31_t *p_output, uint32_t count )
+{
+	// scaled through block[] a block at a time, so p_input is left alone
+	uint32_t i, n;
+	filter_q31_flush( p_filter );
+	while( count )
+	{
+		n = count < FILTER_BLOCK_SIZE ? count : FILTER_BLOCK_SIZE;
+		for( i = 0; i < n; i++ )
+			p_filter->block[i] = q31_in( p_input[i] );
+		biquad_q31( &p_filter->filter, p_filter->block, p_filter->block, n );
+		for( i = 0; i < n; i++ )
+			p_output[i] = q31_out( p_filter->block[i] );
+		p_filter->output = p_output[n-1];
+		p_input += n;
+		p_output += n;
+		count -= n;
+	}
+}
+
+bool filter_q31_push( filter_q31_t *p_filter, q31_t sample )
+{
+	p_filter->block[p_filter->count++] = q31_in( sample );
+	if( p_filter->count < FILTER_BLOCK_SIZE )
+		return false;
+	filter_q31_flush( p_filter );
+	return true;
+}
+
+uint8_t filter_q31_flush( filter_q31_t *p_filter )
+{
+	uint8_t i, count = p_filter->count;
+	if( count )
+	{
+		biquad_q31( &p_filter->filter, p_filter->block, p_filter->block, count );
+		for( i = 0; i < count; i++ )
+			p_filter->block[i] = q31_out( p_filter->block[i] );
+		p_filter->output = p_filter->block[count-1];
+		p_filter->count = 0;
+	}
+	return count;
+}
+
+static void bank_coef( filter_bank_t *p_bank, const float_t *p_coef, uint8_t stages )
+{
+	uint8_t s;
+	float_t gain = 1.0f;
+	memcpy( p_bank->coef, p_coef, 5 * stages * sizeof(float_t) );
+	for( s = 0; s < stages; s++ )
+	{
+		const float_t *p = &p_coef[5*s];
+		gain *= ( p[0] + p[1] + p[2] ) / ( 1.0f - p[3] - p[4] );
+		p_bank->gain[s] = gain;
+	}
+	p_bank->stages = stages;
+}
+
+static void bank_recentre( filter_bank_t *p_bank, uint8_t c, int32_t delta )
+{
+	// move the channel's origin to its latest input.  every stage is in steady state with
+	// respect to a constant, so shifting each stage's history by the constant times the
+	// DC gain ahead of it leaves the output unchanged.
+	uint8_t s;
+	float_t d = (float_t)delta;
+	float_t gain_in = 1.0f;
+	p_bank->origin[c] += delta;
+	for( s = 0; s < p_bank->stages; s++ )
+	{
+		p_bank->x1[s][c] -= d * gain_in;
+		p_bank->x2[s][c] -= d * gain_in;
+		p_bank->y1[s][c] -= d * p_bank->gain[s];
+		p_bank->y2[s][c] -= d * p_bank->gain[s];
+		gain_in = p_bank->gain[s];
+	}
+}
+
+static void bank_stage( filter_bank_t *p_bank, uint8_t s, float_t *p_x )
+{
+	// one biquad stage across every channel.  p_x is replaced by the stage output.
+	const float_t *p_coef = &p_bank->coef[5*s];
+	float_t *p_x1 = p_bank->x1[s];
+	float_t *p_x2 = p_bank->x2[s];
+	float_t *p_y1 = p_bank->y1[s];
+	float_t *p_y2 = p_bank->y2[s];
+	// The Cortex-M4 FPU is scalar:  it has no float SIMD, and the DSP extension's SIMD works
+	// on 8 and 16 bit lanes, too narrow for hit times, so an unrolled FPU loop is as fast as
+	// this gets on the target.  Four channels per pass.  their multiply-accumulate chains are
+	// independent, so the FPU works on one while the others' results are still in its
+	// pipeline.  the padding channels hold zero, so running into them costs nothing but time.
+	const float_t b0 = p_coef[0], b1 = p_coef[1], b2 = p_coef[2], a1 = p_coef[3], a2 = p_coef[4];
+	uint8_t c, end = ( p_bank->channels + 3 ) & ~3;
+	for( c = 0; c < end; c += 4 )
+	{
+		float_t in0 = p_x[c], in1 = p_x[c+1], in2 = p_x[c+2], in3 = p_x[c+3];
+		float_t out0 = b0 * in0 + b1 * p_x1[c]   + b2 * p_x2[c]   + a1 * p_y1[c]   + a2 * p_y2[c];
+		float_t out1 = b0 * in1 + b1 * p_x1[c+1] + b2 * p_x2[c+1] + a1 * p_y1[c+1] + a2 * p_y2[c+1];
+		float_t out2 = b0 * in2 + b1 * p_x1[c+2] + b2 * p_x2[c+2] + a1 * p_y1[c+2] + a2 * p_y2[c+2];
+		float_t out3 = b0 * in3 + b1 * p_x1[c+3] + b2 * p_x2[c+3] + a1 * p_y1[c+3] + a2 * p_y2[c+3];
+		p_x2[c] = p_x1[c];	p_x2[c+1] = p_x1[c+1];	p_x2[c+2] = p_x1[c+2];	p_x2[c+3] = p_x1[c+3];
+		p_x1[c] = in0;		p_x1[c+1] = in1;		p_x1[c+2] = in2;		p_x1[c+3] = in3;
+		p_y2[c] = p_y1[c];	p_y2[c+1] = p_y1[c+1];	p_y2[c+2] = p_y1[c+2];	p_y2[c+3] = p_y1[c+3];
+		p_y1[c] = out0;		p_y1[c+1] = out1;		p_y1[c+2] = out2;		p_y1[c+3] = out3;
+		p_x[c] = out0;		p_x[c+1] = out1;		p_x[c+2] = out2;		p_x[c+3] = out3;
+	}
+}
+
+void filter_bank_init( filter_bank_t *p_bank, uint8_t channels, float_t rate )
+{
+	memset( p_bank, 0, sizeof(filter_bank_t) );
+	p_bank->channels = channels > FILTER_BANK_WIDTH ? FILTER_BANK_WIDTH : channels;
+	filter_bank_tune( p_bank, rate > 0 ? rate : DEFAULT_RATE );
+}
+
+bool filter_bank_tune( filter_bank_t *p_bank, float_t rate )
+{
+	const design_t *p_design;
+	if( rate <= 0 || ( rate == p_bank->rate && p_bank->design == s_design ) )
+		return false;
+	p_design = lookup( rate );
+	if( p_design->stages != p_bank->stages )
+	{
+		// restart from the next input rather than carry history across a different layout
+		memset( p_bank->x1, 0, sizeof(p_bank->x1) );
+		memset( p_bank->x2, 0, sizeof(p_bank->x2) );
+		memset( p_bank->y1, 0, sizeof(p_bank->y1) );
+		memset( p_bank->y2, 0, sizeof(p_bank->y2) );
+		p_bank->primed = false;
+	}
+	bank_coef( p_bank, p_design->coef, p_design->stages );
+	p_bank->rate = rate;
+	p_bank->design = s_design;
+	return true;
+}
+
+void filter_bank_sample( filter_bank_t *p_bank, const int32_t *p_input )
+{
+	// one sample for every channel.  results are left in output[].
+	float_t x[FILTER_BANK_WIDTH];
+	uint8_t c, s;
+	for( c = 0; c < p_bank->channels; c++ )
+	{
+		int32_t delta;
+		if( !p_bank->primed )
+			p_bank->origin[c] = p_input[c];
+		delta = p_input[c] - p_bank->origin[c];
+		if( delta > BANK_RECENTRE || delta < -BANK_RECENTRE )
+		{
+			bank_recentre( p_bank, c, delta );
+			delta = 0;
+		}
+		x[c] = (float_t)delta;
+	}
+	for( ; c < FILTER_BANK_WIDTH; c++ )
+		x[c] = 0;
+	p_bank->primed = true;
+	for( s = 0; s < p_bank->stages; s++ )
+		bank_stage( p_bank, s, x );
+	for( c = 0; c < p_bank->channels; c++ )
+		p_bank->output[c] = p_bank->origin[c] + (int32_t)( x[c] < 0 ? x[c] - 0.5f : x[c] + 0.5f );
+}
+
+bool filter_set_design( filter_type_t type, uint8_t order, float_t cutoff )
+{
+	if( type > filter_type_bessel || !order || order > FILTER_MAX_ORDER || cutoff <= 0 )
+		return false;
+	if( type == s_type && order == s_order && cutoff == s_cutoff )
+		return true;
+	s_type = type;
+	s_order = order;
+	s_cutoff = cutoff;
+	memset( s_cache, 0, sizeof(s_cache) );
+	s_cache_next = 0;
+	if( !++s_design )
+		s_design = 1;	// 0 is never a valid generation, so a new filter always gets tuned
+	return true;
+}
+
+filter_type_t filter_get_type( void )
+{
+	return s_type;
+}
+
+uint8_t filter_get_order( void )
+{
+	return s_order;
+}
+
+float_t filter_get_cutoff( void )
+{
+	return s_cutoff;
+}
@@ -5,15 +5,97 @@
 
 #include <arm_math.h>
 
+#define FILTER_STAGES		2	// up to 4th order
+#define FILTER_MAX_ORDER	(2*FILTER_STAGES)
+#define FILTER_BLOCK_SIZE	8	// most samples run through the cascade in one call
+
+typedef enum _filter_type_t
+{
+	filter_type_butterworth,	// flattest passband
+	filter_type_bessel			// no overshoot on a step in flow
+}
+filter_type_t;
+
 typedef struct _filter_t
 {
 	arm_biquad_casd_df1_inst_f32 filter;
-	float_t 	state[8];
-	float_t 	output;
+	float_t 	state[4*FILTER_STAGES];
+	float_t		coef[5*FILTER_STAGES];
+	float_t		rate;						// sampling rate the coefficients were designed for
+	uint8_t		design;						// design generation the coefficients came from
+	float_t 	output;						// most recent output
+	float_t		block[FILTER_BLOCK_SIZE];	// pending input, filtered in place by filter_flush()
+	uint8_t		count;
 }
 filter_t;
 
-void filter_init( filter_t *p_filter );
+// Q31 variant for fixed point inputs such as the raw tof_diff.  Coefficients are held as
+// Q1.30 (postShift 1) so feedback terms up to 2 fit.  Inputs are scaled up by
+// FILTER_Q31_GUARD bits inside the filter and saturate at +/-2^(30-FILTER_Q31_GUARD);  the
+// output and block[] are back in input units.  Building with FILTER_Q31_FAST uses the
+// 32 bit accumulator kernel:  quicker, but it rounds at every stage.
+
+#ifndef FILTER_Q31_GUARD
+#define FILTER_Q31_GUARD	8	// inputs up to 2^22, a 16us tof_diff in Q16.16
+#endif
+
+typedef struct _filter_q31_t
+{
+	arm_biquad_casd_df1_inst_q31 filter;
+	q31_t		state[4*FILTER_STAGES];
+	q31_t		coef[5*FILTER_STAGES];
+	float_t		rate;
+	uint8_t		design;
+	q31_t		output;
+	q31_t		block[FILTER_BLOCK_SIZE];
+	uint8_t		count;
+}
+filter_q31_t;
+
+// Bank of identical filters over parallel channels, such as the individual up and down hit
+// times.  State is stored structure of arrays, one row per stage, so a stage runs across
+// every channel with the coefficients held in registers, four channels at a time.
+// Inputs are 32 bit fixed point.  Each channel filters its offset from a per-channel origin
+// so the float math keeps full resolution on large absolute times.
+
+#define FILTER_BANK_WIDTH	16	// channels, a multiple of the four bank_stage() runs per pass
+
+typedef struct _filter_bank_t
+{
+	float_t		coef[5*FILTER_STAGES];
+	float_t		gain[FILTER_STAGES];		// DC gain up to and including each stage
+	uint8_t		stages;
+	uint8_t		channels;
+	float_t		rate;
+	uint8_t		design;
+	bool		primed;
+	int32_t		origin[FILTER_BANK_WIDTH];
+	float_t		x1[FILTER_STAGES][FILTER_BANK_WIDTH];
+	float_t		x2[FILTER_STAGES][FILTER_BANK_WIDTH];
+	float_t		y1[FILTER_STAGES][FILTER_BANK_WIDTH];
+	float_t		y2[FILTER_STAGES][FILTER_BANK_WIDTH];
+	int32_t		output[FILTER_BANK_WIDTH];
+}
+filter_bank_t;
+
+void filter_init( filter_t *p_filter, float_t rate );
+bool filter_tune( filter_t *p_filter, float_t rate );
 float_t filter_sample( filter_t *p_filter, float_t sample );
+void filter_block( filter_t *p_filter, float_t *p_input, float_t *p_output, uint32_t count );
+bool filter_push( filter_t *p_filter, float_t sample );
+uint8_t filter_flush( filter_t *p_filter );
+void filter_q31_init( filter_q31_t *p_filter, float_t rate );
+bool filter_q31_tune( filter_q31_t *p_filter, float_t rate );
+q31_t filter_q31_sample( filter_q31_t *p_filter, q31_t sample );
+void filter_q31_block( filter_q31_t *p_filter, q31_t *p_input, q31_t *p_output, uint32_t count );
+bool filter_q31_push( filter_q31_t *p_filter, q31_t sample );
+uint8_t filter_q31_flush( filter_q31_t *p_filter );
+void filter_bank_init( filter_bank_t *p_bank, uint8_t channels, float_t rate );
+bool filter_bank_tune( filter_bank_t *p_bank, float_t rate );
+void filter_bank_sample( filter_bank_t *p_bank, const int32_t *p_input );
+bool filter_set_design( filter_type_t type, uint8_t order, float_t cutoff );
+filter_type_t filter_get_type( void );
+uint8_t filter_get_order( void );
+float_t filter_get_cutoff( void );
 
 #endif
@@ -0,0 +1,94 @@
+/*******************************************************************************
+ * Copyright (C) 2017 Maxim Integrated Products, Inc., All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL MAXIM INTEGRATED BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Except as contained in this notice, the name of Maxim Integrated
+ * Products, Inc. shall not be used except as stated in the Maxim Integrated
+ * Products, Inc. Branding Policy.
+ *
+ * The mere transfer of this software does not imply any licenses
+ * of trade secrets, proprietary technology, copyrights, patents,
+ * trademarks, maskwork rights, or any other form of intellectual
+ * property whatsoever. Maxim Integrated Products, Inc. retains all
+ * ownership rights.
+ *
+ ******************************************************************************/
+
+#include "global.h"
+#include "fixed.h"
+
+// Q16 reciprocals of the hit count.  Averaging costs a 64-bit multiply instead of a divide.
+static const uint32_t s_reciprocal[MAX3510X_MAX_HITCOUNT+1] =
+{
+	0, 65536, 32768, 21845, 16384, 13107, 10923
+};
+
+fixed_t fixed_average( const fixed_t *p_hit, uint8_t hitcount )
+{
+	uint8_t i;
+	int64_t sum = 0;
+	for(i=0;i<hitcount;i++)
+	{
+		sum += p_hit[i];
+	}
+	return (fixed_t)( (sum * s_reciprocal[hitcount]) >> 16 );
+}
+
+static void measurement( fixed_measurement_t *p_fixed, const max3510x_measurement_t *p_measurement, uint8_t hitcount )
+{
+	uint8_t i;
+	for(i=0;i<hitcount;i++)
+	{
+		p_fixed->hit[i] = fixed_from_max3510x( &p_measurement->hit[i] );
+	}
+	p_fixed->average = fixed_average( &p_fixed->hit[0], hitcount );
+}
+
+void fixed_tof( fixed_tof_t *p_tof, const max3510x_tof_results_t *p_results, uint8_t hitcount )
+{
+	// unpack the raw result registers and compute the per-direction average and difference
+	// without leaving the integer domain.
+	if( hitcount > MAX3510X_MAX_HITCOUNT )
+		hitcount = MAX3510X_MAX_HITCOUNT;
+	measurement( &p_tof->up, &p_results->up, hitcount );
+	measurement( &p_tof->down, &p_results->down, hitcount );
+	p_tof->tof_diff = p_tof->up.average - p_tof->down.average;
+}
+
+static fixed_t scale( fixed_t value, int32_t scale )
+{
+	return (fixed_t)( ((int64_t)value * scale) >> 30 );
+}
+
+void fixed_tof_scale( fixed_tof_t *p_tof, int32_t factor, uint8_t hitcount )
+{
+	// apply a Q2.30 reference clock correction to every time in p_tof
+	uint8_t i;
+	if( hitcount > MAX3510X_MAX_HITCOUNT )
+		hitcount = MAX3510X_MAX_HITCOUNT;
+	for(i=0;i<hitcount;i++)
+	{
+		p_tof->up.hit[i] = scale( p_tof->up.hit[i], factor );
+		p_tof->down.hit[i] = scale( p_tof->down.hit[i], factor );
+	}
+	p_tof->up.average = scale( p_tof->up.average, factor );
+	p_tof->down.average = scale( p_tof->down.average, factor );
+	p_tof->tof_diff = scale( p_tof->tof_diff, factor );
+}
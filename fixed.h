@@ -0,0 +1,80 @@
+/*******************************************************************************
+ * Copyright (C) 2017 Maxim Integrated Products, Inc., All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL MAXIM INTEGRATED BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Except as contained in this notice, the name of Maxim Integrated
+ * Products, Inc. shall not be used except as stated in the Maxim Integrated
+ * Products, Inc. Branding Policy.
+ *
+ * The mere transfer of this software does not imply any licenses
+ * of trade secrets, proprietary technology, copyrights, patents,
+ * trademarks, maskwork rights, or any other form of intellectual
+ * property whatsoever. Maxim Integrated Products, Inc. retains all
+ * ownership rights.
+ *
+ ******************************************************************************/
+
+#ifndef __FIXED_H__
+#define __FIXED_H__
+
+#include "max3510x.h"
+
+// Time values are carried through the measurement pipeline as signed Q16.16 multiples
+// of the 4MHz TDC reference period, the same representation the MAX3510x uses for
+// its result registers.  This covers +/-8.19ms, enough for any TIMOUT setting up to 8192us.
+
+typedef int32_t fixed_t;
+
+#define FIXED_SHIFT			16
+#define FIXED_ONE			((fixed_t)1<<FIXED_SHIFT)
+#define FIXED_CLOCK_FREQ	4000000.0f
+#define FIXED_TO_SECONDS	(1.0f/(65536.0f*FIXED_CLOCK_FREQ))
+
+typedef struct _fixed_measurement_t
+{
+	fixed_t	hit[MAX3510X_MAX_HITCOUNT];
+	fixed_t	average;
+}
+fixed_measurement_t;
+
+typedef struct _fixed_tof_t
+{
+	fixed_measurement_t	up;
+	fixed_measurement_t	down;
+	fixed_t				tof_diff;	// up - down
+}
+fixed_tof_t;
+
+static inline fixed_t fixed_from_max3510x( const max3510x_fixed_t *p_fixed )
+{
+	return (fixed_t)( ((uint32_t)MAX3510X_ENDIAN(p_fixed->integer) << FIXED_SHIFT) | (uint16_t)MAX3510X_ENDIAN(p_fixed->fraction) );
+}
+
+static inline float_t fixed_to_float( fixed_t value )
+{
+	// converts to seconds.  Only done at the output edge of the pipeline.
+	return (float_t)value * FIXED_TO_SECONDS;
+}
+
+void fixed_tof( fixed_tof_t *p_tof, const max3510x_tof_results_t *p_results, uint8_t hitcount );
+void fixed_tof_scale( fixed_tof_t *p_tof, int32_t scale, uint8_t hitcount );
+fixed_t fixed_average( const fixed_t *p_hit, uint8_t hitcount );
+
+#endif
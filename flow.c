@@ -37,6 +37,18 @@
 #include "uui.h"
 #include "config.h"
 #include "transducer.h"
+#include "fixed.h"
+#include "flowbody.h"
+#include "totalizer.h"
+#include "temperature.h"
+#include "calibration.h"
+#include "autotune.h"
+#include "sweep.h"
+#include "fusion.h"
+#include "zero.h"
+#include "recovery.h"
+#include "filter.h"
+#include "hampel.h"
 
 typedef enum _sampling_process_event_t
 {
@@ -46,218 +58,815 @@ typedef enum _sampling_process_event_t
 }
 sampling_process_event_t;
 
+#define WAVE_TRACK_RELOCK	8	// consecutive slips in the same direction accepted as a real step
+
 typedef struct _wave_track_t
 {
-	max3510x_time_t last[MAX3510X_MAX_HITCOUNT];
-	uint8_t			hitwaves[MAX3510X_MAX_HITCOUNT];
+	fixed_t		last;		// corrected average from the previous sample
+	bool		valid;
+	int8_t		pending;	// consecutive slips in the same direction
+	uint32_t	slips;
 }
 wave_track_t;
 
+#define SAMPLE_QUEUE_SIZE	8	// must be a power of two
+
+typedef struct _sample_t
+{
+	uint16_t				status;		// interrupt status that produced this sample
+	uint8_t					instance;	// TDC that produced this sample
+	uint8_t					cmd;		// flow_seq_cmd_t that produced this sample
+	uint8_t					gain_slot;	// interleaved PGA gain in use
+	bool					clocked;	// started by the host mode sampling clock
+	uint32_t				trigger;	// timestamp of the clock tick that started it
+	float_t					time;		// time since the previous sample
+	max3510x_tof_results_t	tof;
+	max3510x_register7_t	temp_evtmg;
+	max3510x_register6_t	temp;
+	max3510x_fixed_t		cal;
+}
+sample_t;
+
+typedef struct _sample_queue_t
+{
+	// single-producer/single-consumer ring.  head and tail are free running.
+	sample_t			sample[SAMPLE_QUEUE_SIZE];
+	volatile uint8_t	head;
+	volatile uint8_t	tail;
+	uint8_t				high_water;
+	uint32_t			overflow;
+}
+sample_queue_t;
+
+typedef struct _sequence_t
+{
+	flow_seq_slot_t	slot[FLOW_SEQ_MAX_SLOTS];
+	uint8_t			count;
+}
+sequence_t;
+
+typedef struct _rate_t
+{
+	// sample rate of one filtered stream, measured once a second
+	uint32_t		time;
+	uint16_t		count;
+	float_t			rate;
+}
+rate_t;
+
+typedef struct _sequence_cursor_t
+{
+	uint8_t			ndx;		// current slot
+	uint8_t			remaining;	// repeats left in the current slot
+	uint8_t			cmd;		// command in flight
+}
+sequence_cursor_t;
+
+// Everything that belongs to one TDC.  The sequence table, sampling mode and flow body
+// settings are shared;  each instance keeps its own place in the sequence.
+// Calibration, autotune and sweeps act on instance 0, the default device.
+
+typedef struct _flow_instance_t
+{
+	max3510x_t				device;
+	bool					present;		// has a TDC of its own
+	flow_sampling_mode_t	mode;			// mode this instance was last started in
+	bool					response_pending;
+	bool					holding;		// backing off after repeated timeouts
+	bool					clocked;		// measurement in flight was started by the clock
+	uint32_t				trigger;		// clock tick that started it
+	bool					tick_pending;	// a clock tick arrived while the TDC was busy
+	uint32_t				tick;			// time of the latest clock tick
+	uint32_t				last_sample_time;
+	uint8_t					hitcount;
+	uint8_t					hitwaves[MAX3510X_MAX_HITCOUNT];
+	sequence_cursor_t		cursor;
+	wave_track_t			wave_track[2];	// up, down
+	flowbody_result_t		flowbody_result;
+	filter_q31_t			tof_filter;		// smooths the raw tof_diff without leaving fixed point
+	filter_bank_t			hit_filter;		// smooths each up hit, then each down hit
+	rate_t					tof_rate;		// rates the two filters above see
+	rate_t					hit_rate;
+	float_t					tof_interval;
+	float_t					temperature;
+}
+flow_instance_t;
+
 static flow_sampling_mode_t		s_flow_sampling_mode;
-static flow_sampling_mode_t		s_last_flow_sampling_mode;
+static bool						s_clock_enabled;
 static flow_sos_method_t 		s_sos_method;
 
-static bool 					s_response_pending;
 static float_t					s_sampling_freq;
 
 static flow_sampling_mode_t s_requested_flow_sampling_mode;
 
-static uint32_t s_last_sample_time;
 static int16_t 	s_tof_temp;
-static int16_t 	s_tof_temp_count;
 static max3510x_event_timing_mode_t s_event_timing_mode;
-static void (*s_p_next_measurement)(max3510x_t);
-static uint8_t s_hitcount;
+static sample_queue_t s_queue;
+static sequence_t s_sequence;
+static flow_instance_t s_instance[FLOW_INSTANCE_COUNT];
+static uint8_t s_next_instance;		// round robin start for interrupt servicing
+static uint32_t s_trigger;				// timestamp of the clock tick being serviced
+static filter_t s_filter;			// smooths the fused flow
+static rate_t s_filter_rate;		// fused output rate
+static flow_sampling_mode_t s_sweep_restore_mode = flow_sampling_mode_invalid;
+static flow_instance_t *s_p_readout;		// instance whose results are being transferred
+static volatile bool s_readout_complete;	// set by flow_readout_complete()
+
+#ifndef __weak
+#define __weak __attribute__((weak))
+#endif
 
-static void interleave( void )
+__weak bool board_max3510x_read_async( max3510x_t device, uint8_t reg, void *p_dst, uint16_t size )
 {
-	if( s_tof_temp > 0  )
+	// boards without a DMA capable SPI path fall back to blocking reads
+	return false;
+}
+
+static void sequence_rewind( flow_instance_t *p_instance )
+{
+	p_instance->cursor.ndx = 0;
+	p_instance->cursor.remaining = s_sequence.slot[0].repeat;
+}
+
+static void sequence_rewind_all( void )
+{
+	uint8_t i;
+	for( i = 0; i < FLOW_INSTANCE_COUNT; i++ )
+		sequence_rewind( &s_instance[i] );
+}
+
+static void sequence_from_tof_temp( int16_t tof_temp )
+{
+	// legacy 1:N pattern.  positive values run N tof_diff's per temperature measurement,
+	// negative values run N temperature measurements per tof_diff.
+	flow_seq_slot_t *p_slot = &s_sequence.slot[0];
+	if( tof_temp > 0 )
 	{
-		s_tof_temp_count++;
-		if( s_tof_temp_count >= s_tof_temp )
-		{
-			s_tof_temp_count = 0;
-		}
+		p_slot[0].cmd = flow_seq_cmd_tof_diff;
+		p_slot[0].repeat = tof_temp > 255 ? 255 : tof_temp;
+		p_slot[0].priority = flow_seq_priority_high;
+		p_slot[1].cmd = flow_seq_cmd_temp;
+		p_slot[1].repeat = 1;
+		p_slot[1].priority = flow_seq_priority_low;
+		s_sequence.count = 2;
 	}
-	else if( s_tof_temp <= 0  )
+	else if( tof_temp < 0 )
 	{
-		s_tof_temp_count--;
-		if( s_tof_temp_count <= s_tof_temp )
-		{
-			s_tof_temp_count = 0;
-		}
+		p_slot[0].cmd = flow_seq_cmd_temp;
+		p_slot[0].repeat = tof_temp < -255 ? 255 : -tof_temp;
+		p_slot[0].priority = flow_seq_priority_high;
+		p_slot[1].cmd = flow_seq_cmd_tof_diff;
+		p_slot[1].repeat = 1;
+		p_slot[1].priority = flow_seq_priority_low;
+		s_sequence.count = 2;
+	}
+	else
+	{
+		p_slot[0].cmd = flow_seq_cmd_tof_diff;
+		p_slot[0].repeat = 1;
+		p_slot[0].priority = flow_seq_priority_high;
+		s_sequence.count = 1;
+	}
+	sequence_rewind_all();
+}
+
+static const flow_seq_slot_t * sequence_peek( flow_instance_t *p_instance )
+{
+	return &s_sequence.slot[p_instance->cursor.ndx];
+}
+
+static void sequence_next_slot( flow_instance_t *p_instance )
+{
+	sequence_cursor_t *p_cursor = &p_instance->cursor;
+	if( ++p_cursor->ndx >= s_sequence.count )
+		p_cursor->ndx = 0;
+	p_cursor->remaining = s_sequence.slot[p_cursor->ndx].repeat;
+}
+
+static void sequence_advance( flow_instance_t *p_instance )
+{
+	sequence_cursor_t *p_cursor = &p_instance->cursor;
+	if( !p_cursor->remaining || !--p_cursor->remaining )
+		sequence_next_slot( p_instance );
+}
+
+static void sequence_skip_low( flow_instance_t *p_instance )
+{
+	// a clock tick arrived before the low priority slots got their turn.
+	// drop them rather than let them push the paced measurements out.
+	uint8_t i;
+	for( i = 0; i < s_sequence.count && sequence_peek( p_instance )->priority == flow_seq_priority_low; i++ )
+		sequence_next_slot( p_instance );
+}
+
+static void measurement_run( flow_instance_t *p_instance, uint8_t cmd )
+{
+	max3510x_t device = p_instance->device;
+	p_instance->clocked = false;
+	if( p_instance == &s_instance[0] )
+	{
+		if( sweep_active() )
+			sweep_apply();	// the sweep owns the settings until it's done
+		else
+			autotune_apply( cmd == flow_seq_cmd_tof_diff || cmd == flow_seq_cmd_tof_up || cmd == flow_seq_cmd_tof_down );
+	}
+	p_instance->cursor.cmd = cmd;
+	switch( cmd )
+	{
+		case flow_seq_cmd_tof_up:
+			max3510x_tof_up(device);
+			break;
+		case flow_seq_cmd_tof_down:
+			max3510x_tof_down(device);
+			break;
+		case flow_seq_cmd_temp:
+			max3510x_temperature(device);
+			break;
+		case flow_seq_cmd_cal:
+			max3510x_calibrate(device);
+			break;
+		default:
+			max3510x_tof_diff(device);
+			break;
 	}
+	p_instance->response_pending = true;
 }
 
-static void tof_diff( void *v )
+static void sequence_run( flow_instance_t *p_instance )
 {
-    max3510x_tof_diff(NULL);
+	uint8_t cmd = sequence_peek( p_instance )->cmd;
+	sequence_advance( p_instance );
+	measurement_run( p_instance, cmd );
 }
 
-static void start_next_measurement( bool clock )
+static bool calibration_next( flow_instance_t *p_instance )
 {
+	// only the default device is calibrated
+	return p_instance == &s_instance[0] && p_instance->cursor.cmd != flow_seq_cmd_cal &&
+		calibration_due( p_instance->temperature );
+}
+
+static void clock_update( void )
+{
+	// the sampling clock paces host mode.  it also wakes the loop while a TDC is holding off
+	// after timeouts, since in max mode nothing else would until the backoff expired.
+	bool enable = s_flow_sampling_mode == flow_sampling_mode_host;
+	uint8_t i;
+	for( i = 0; i < FLOW_INSTANCE_COUNT; i++ )
+		if( s_instance[i].holding )
+			enable = true;
+	if( enable != s_clock_enabled )
+	{
+		board_clock_enable( enable );
+		s_clock_enabled = enable;
+	}
+}
+
+static void mode_update( void )
+{
+	// sampling mode changes that affect the whole meter rather than one TDC
+	if( s_sweep_restore_mode != flow_sampling_mode_invalid && !sweep_active() )
+	{
+		s_requested_flow_sampling_mode = s_sweep_restore_mode;
+		s_sweep_restore_mode = flow_sampling_mode_invalid;
+	}
 
 	if( s_requested_flow_sampling_mode != flow_sampling_mode_invalid )
 	{
 		s_flow_sampling_mode = s_requested_flow_sampling_mode;
 		s_requested_flow_sampling_mode = flow_sampling_mode_invalid;
 	}
-	if( s_flow_sampling_mode != flow_sampling_mode_host )
+	clock_update();
+}
+
+static void start_next_measurement( flow_instance_t *p_instance, bool clock )
+{
+	max3510x_t device = p_instance->device;
+
+	mode_update();
+
+	if( p_instance->mode == flow_sampling_mode_event  &&
+			s_flow_sampling_mode != flow_sampling_mode_event )
+		max3510x_halt(device);
+
+	if( (p_instance->mode == flow_sampling_mode_invalid ||
+		p_instance->mode == flow_sampling_mode_idle) &&
+		(s_flow_sampling_mode != flow_sampling_mode_invalid &&
+		 s_flow_sampling_mode != flow_sampling_mode_idle ) )
 	{
-		if( s_last_flow_sampling_mode == flow_sampling_mode_host )
-			board_clock_enable(false);
+		p_instance->hitcount = MAX3510X_REG_TOF2_STOP(MAX3510X_READ_BITFIELD(device,TOF2,STOP));
+		max3510x_get_hitwaves( device, &p_instance->hitwaves[0] );
+		p_instance->wave_track[0].valid = false;
+		p_instance->wave_track[1].valid = false;
+		// don't count the idle time against the first sample
+		p_instance->last_sample_time = board_timestamp();
+		p_instance->tof_interval = 0;
 	}
-	if( s_last_flow_sampling_mode == flow_sampling_mode_event  &&
-			s_flow_sampling_mode != flow_sampling_mode_event )
-		max3510x_halt(NULL);
 
 	if( (s_flow_sampling_mode == flow_sampling_mode_max) )
 	{
-		if( s_tof_temp > 0  )
+		if( calibration_next( p_instance ) )
+			measurement_run( p_instance, flow_seq_cmd_cal );
+		else
+			sequence_run( p_instance );
+	}
+	else if( s_flow_sampling_mode == flow_sampling_mode_host )
+	{
+		if (clock)
 		{
-			if( s_tof_temp_count == 1 )
-				max3510x_temperature(NULL);
-			else
-			{
-				tof_diff(NULL);
-			}
+			sequence_skip_low( p_instance );
+			sequence_run( p_instance );
+			p_instance->clocked = true;
+			p_instance->trigger = p_instance->tick;
 		}
-		else if( s_tof_temp < 0 )
+		else if( calibration_next( p_instance ) )
 		{
-			if( s_tof_temp_count == -1 )
-				tof_diff(NULL);
-			else
-			{
-				max3510x_temperature(NULL);
-			}
+			// squeeze the calibration in behind the paced measurement
+			measurement_run( p_instance, flow_seq_cmd_cal );
 		}
-		else
+		else if( sequence_peek( p_instance )->priority == flow_seq_priority_low )
 		{
-			tof_diff(NULL);
+			sequence_run( p_instance );
 		}
-		interleave();
-		s_response_pending = true;
 	}
-	else if( s_flow_sampling_mode == flow_sampling_mode_host )
+	else if( s_flow_sampling_mode == flow_sampling_mode_event  )
 	{
-		if( s_last_flow_sampling_mode != flow_sampling_mode_host )
+		if( p_instance->mode != flow_sampling_mode_event )
 		{
-			board_clock_enable(true);
+			// event timing mode runs its own sequence on the TDC
+			p_instance->cursor.cmd = flow_seq_cmd_tof_diff;
+			max3510x_event_timing(device,s_event_timing_mode);
 		}
-		if (clock)
+	}
+	p_instance->mode = s_flow_sampling_mode;
+}
+
+static void start_all( bool clock )
+{
+	// the TDCs measure concurrently and only share the SPI bus for commands and readout.
+	// a fresh start ends any timeout backoff.
+	uint8_t i;
+	s_trigger = board_timestamp();
+	for( i = 0; i < FLOW_INSTANCE_COUNT; i++ )
+	{
+		if( !s_instance[i].present )
+			continue;
+		s_instance[i].holding = false;
+		s_instance[i].tick_pending = false;
+		s_instance[i].tick = s_trigger;
+		start_next_measurement( &s_instance[i], clock );
+	}
+}
+
+static void restart( flow_instance_t *p_instance )
+{
+	// the TDC is free again.  a clock tick that arrived while it was busy starts the next
+	// paced measurement now rather than having overwritten the one in flight.
+	bool clock = p_instance->tick_pending;
+	p_instance->response_pending = false;
+	p_instance->tick_pending = false;
+	start_next_measurement( p_instance, clock );
+}
+
+static bool response_pending( void )
+{
+	uint8_t i;
+	for( i = 0; i < FLOW_INSTANCE_COUNT; i++ )
+	{
+		if( s_instance[i].response_pending )
+			return true;
+	}
+	return false;
+}
+
+static sample_t * queue_reserve( void )
+{
+	// producer side:  returns the next free slot or NULL if the consumer has fallen behind.
+	// Slots stay owned by the producer until queue_commit() so the TDC can be refilling one
+	// while the consumer works on another.
+	if( (uint8_t)(s_queue.head - s_queue.tail) >= SAMPLE_QUEUE_SIZE )
+	{
+		s_queue.overflow++;
+		return NULL;
+	}
+	return &s_queue.sample[s_queue.head & (SAMPLE_QUEUE_SIZE-1)];
+}
+
+static void queue_commit( void )
+{
+	// publish the reserved slot.  head is only written by the producer.
+	uint8_t depth;
+	s_queue.head++;
+	depth = s_queue.head - s_queue.tail;
+	if( depth > s_queue.high_water )
+		s_queue.high_water = depth;
+}
+
+static const sample_t * queue_peek( void )
+{
+	// consumer side:  returns the oldest sample or NULL if the queue is empty
+	if( s_queue.head == s_queue.tail )
+		return NULL;
+	return &s_queue.sample[s_queue.tail & (SAMPLE_QUEUE_SIZE-1)];
+}
+
+static void queue_release( void )
+{
+	// tail is only written by the consumer.
+	s_queue.tail++;
+}
+
+static void readout( flow_instance_t *p_instance, uint16_t status )
+{
+	// read the raw results out of the TDC into the next free slot, then restart the TDC
+	// before the sample is converted or reported.
+	// The whole result block for each interrupt source is fetched in a single burst.  A TOF
+	// result block, the bulk of the traffic, goes by DMA where the board can;  the slot is
+	// published and the TDC restarted by readout_finish() once it lands.
+
+	max3510x_t device = p_instance->device;
+	sample_t *p_sample = queue_reserve();
+	recovery_success( p_instance - &s_instance[0], p_instance->cursor.cmd );
+#ifdef MAX35104
+	if( p_instance == &s_instance[0] && (status & (MAX3510X_REG_INTERRUPT_STATUS_TOF|MAX3510X_REG_INTERRUPT_STATUS_TOF_EVTMG)) )
+		autotune_tof_complete();
+#endif
+	if( p_sample )
+	{
+		p_sample->status = status;
+		p_sample->instance = p_instance - &s_instance[0];
+		p_sample->cmd = p_instance->cursor.cmd;
+		p_sample->gain_slot = 0;
+#ifdef MAX35104
+		if( p_instance == &s_instance[0] )
+			p_sample->gain_slot = autotune_gain_slot();
+#endif
+		p_sample->clocked = p_instance->clocked;
+		p_sample->trigger = p_instance->trigger;
+		if( p_instance->clocked )
 		{
-			interleave();
-			s_p_next_measurement = NULL;
-			if( s_tof_temp >= 0  )
-			{
-				tof_diff(NULL);
-				if( s_tof_temp_count == 1 )
-					s_p_next_measurement = max3510x_temperature;
-			}
-			else if( s_tof_temp < 0 )
+			// measure from the tick rather than the readout so clocked samples are evenly
+			// spaced no matter how late the main loop got to them
+			float_t since_last, since_trigger;
+			board_elapsed_time( p_instance->last_sample_time, &since_last );
+			board_elapsed_time( p_instance->trigger, &since_trigger );
+			p_sample->time = since_last - since_trigger;
+			p_instance->last_sample_time = p_instance->trigger;
+		}
+		else
+		{
+			p_instance->last_sample_time = board_elapsed_time( p_instance->last_sample_time, &p_sample->time );
+		}
+		if( status & (MAX3510X_REG_INTERRUPT_STATUS_TOF|MAX3510X_REG_INTERRUPT_STATUS_TOF_EVTMG) )
+		{
+			// includes the TDM averaged difference, cycle count and range in event timing mode
+			if( !(status & (MAX3510X_REG_INTERRUPT_STATUS_TEMP_EVTMG|MAX3510X_REG_INTERRUPT_STATUS_TE|MAX3510X_REG_INTERRUPT_STATUS_CAL)) &&
+				board_max3510x_read_async( device, MAX3510X_REG_WVRUP, &p_sample->tof, sizeof(p_sample->tof) ) )
 			{
-				max3510x_temperature(NULL);
-				if( s_tof_temp_count == -1)
-					s_p_next_measurement = tof_diff;
+				s_p_readout = p_instance;
+				return;
 			}
-			s_response_pending = true;
+			max3510x_read_tof_results( device, &p_sample->tof );
 		}
-		else if( s_p_next_measurement )
+		if( status & MAX3510X_REG_INTERRUPT_STATUS_TEMP_EVTMG )
 		{
-			s_p_next_measurement(NULL);
-			s_p_next_measurement = NULL;
-			s_response_pending = true;
+			max3510x_read_registers( device, MAX3510X_REG_TEMP_CYCLE_COUNT, (max3510x_register_t*)&p_sample->temp_evtmg, sizeof(p_sample->temp_evtmg) );
 		}
+		else if( status & MAX3510X_REG_INTERRUPT_STATUS_TE )
+		{
+			max3510x_read_registers( device, MAX3510X_REG_T1INT, (max3510x_register_t*)&p_sample->temp, sizeof(p_sample->temp) );
+		}
+		if( status & MAX3510X_REG_INTERRUPT_STATUS_CAL )
+		{
+			max3510x_read_fixed( device, MAX3510X_REG_CALIBRATIONINT, &p_sample->cal );
+		}
+		queue_commit();
 	}
-	else if( s_flow_sampling_mode == flow_sampling_mode_event  )
+	restart( p_instance );
+}
+
+static void readout_finish( void )
+{
+	// waits out an asynchronous result transfer, then publishes the slot and restarts the TDC.
+	// the TDCs share the bus, so nothing else goes to any of them until this returns.
+	flow_instance_t *p_instance = s_p_readout;
+	if( !p_instance )
+		return;
+	while( !s_readout_complete )
+		;
+	s_readout_complete = false;
+	s_p_readout = NULL;
+	queue_commit();
+	restart( p_instance );
+}
+
+static fixed_t wave_period( const flow_instance_t *p_instance, const fixed_measurement_t *p_measurement )
+{
+	// receive period from the spacing of the first and last hits
+	uint8_t hitcount = p_instance->hitcount;
+	uint8_t last;
+	int16_t waves;
+	if( hitcount < 2 || hitcount > MAX3510X_MAX_HITCOUNT )
+		return 0;
+	last = hitcount - 1;
+	waves = (int16_t)p_instance->hitwaves[last] - (int16_t)p_instance->hitwaves[0];
+	if( waves <= 0 )
+		return 0;
+	return (p_measurement->hit[last] - p_measurement->hit[0]) / waves;
+}
+
+static void wave_track( flow_instance_t *p_instance, wave_track_t *p_track, fixed_measurement_t *p_measurement )
+{
+	// A comparator that locks onto the neighbouring zero crossing moves every hit by one
+	// receive period.  Undo that against the previous sample rather than discarding it.
+	fixed_t period = wave_period( p_instance, p_measurement );
+	fixed_t delta = p_measurement->average - p_track->last;
+	int8_t slip = 0;
+	uint8_t i;
+
+	if( period > 0 && p_track->valid )
 	{
-		if( s_last_flow_sampling_mode != flow_sampling_mode_event )
+		fixed_t half = period >> 1;
+		fixed_t quarter = period >> 2;
+		if( delta > half && delta - period < quarter && delta - period > -quarter )
+			slip = 1;
+		else if( delta < -half && delta + period < quarter && delta + period > -quarter )
+			slip = -1;
+	}
+	if( slip )
+	{
+		if( (slip > 0) != (p_track->pending > 0) )
+			p_track->pending = 0;
+		p_track->pending += slip;
+		if( p_track->pending >= WAVE_TRACK_RELOCK || p_track->pending <= -WAVE_TRACK_RELOCK )
+		{
+			// the shift has persisted, so it's a real change in the flight time
+			p_track->pending = 0;
+		}
+		else
 		{
-			max3510x_event_timing(NULL,s_event_timing_mode);
+			fixed_t correction = slip * period;
+			for( i = 0; i < p_instance->hitcount; i++ )
+				p_measurement->hit[i] -= correction;
+			p_measurement->average -= correction;
+			p_track->slips++;
 		}
 	}
-	if( (s_last_flow_sampling_mode == flow_sampling_mode_invalid ||
-		s_last_flow_sampling_mode == flow_sampling_mode_idle) &&
-		(s_flow_sampling_mode != flow_sampling_mode_invalid && 
-		 s_flow_sampling_mode != flow_sampling_mode_idle ) )
+	else
 	{
-		s_hitcount = MAX3510X_REG_TOF2_STOP(MAX3510X_READ_BITFIELD(NULL,TOF2,STOP));
-		
+		p_track->pending = 0;
 	}
-	s_last_flow_sampling_mode = s_flow_sampling_mode;
+	p_track->last = p_measurement->average;
+	p_track->valid = true;
 }
 
-static void process_flow(uint16_t status)
+static void filter_output( void )
 {
+	filter_push( &s_filter, fusion_result()->flow );
+	s_filter_rate.count++;
+}
 
-	float_t t;
+static float_t paced_rate( void )
+{
+	// host mode starts one high priority slot per clock tick, so when every tof_diff is high
+	// priority the tof_diff rate follows from the slot table.  low priority tof_diffs only
+	// run in whatever time is left over, and then the rate has to be measured.
+	uint16_t diff = 0, high = 0;
 	uint8_t i;
-	if( s_flow_sampling_mode == flow_sampling_mode_idle )
+	if( s_flow_sampling_mode != flow_sampling_mode_host )
+		return 0;
+	for( i = 0; i < s_sequence.count; i++ )
 	{
-		uui_report_tof_temp(status);
-		return;
+		const flow_seq_slot_t *p_slot = &s_sequence.slot[i];
+		uint8_t repeat = p_slot->repeat ? p_slot->repeat : 1;
+		if( p_slot->priority == flow_seq_priority_high )
+		{
+			high += repeat;
+			if( p_slot->cmd == flow_seq_cmd_tof_diff )
+				diff += repeat;
+		}
+		else if( p_slot->cmd == flow_seq_cmd_tof_diff )
+		{
+			return 0;
+		}
 	}
+	return high ? s_sampling_freq * (float_t)diff / (float_t)high : 0;
+}
 
-	if( status & MAX3510X_REG_INTERRUPT_STATUS_TOF )
+static float_t rate_update( rate_t *p_rate, float_t paced )
+{
+	// counted samples are turned into a rate once a second and rounded to whole Hz, with
+	// hysteresis, so the designer's cache sees a handful of keys rather than a new rate
+	// every second.  a paced rate from the slot table takes precedence.
+	float_t elapsed, rate;
+	board_elapsed_time( p_rate->time, &elapsed );
+	if( elapsed >= 1.0f )
 	{
-		max3510x_tof_results_t tof_fixed;
+		rate = roundf( (float_t)p_rate->count / elapsed );
+		p_rate->time = board_timestamp();
+		p_rate->count = 0;
+		if( rate >= 1.0f && ( rate > 1.1f * p_rate->rate || rate < 0.9f * p_rate->rate ) )
+			p_rate->rate = rate;
+	}
+	return paced > 0 ? paced : p_rate->rate;
+}
 
-		max3510x_read_tof_results( NULL, &tof_fixed );
+static void filter_rate_update( void )
+{
+	// each filter is tuned to the rate of the stream it sees.  the fused flow, a path's
+	// tof_diff and its hits can all differ:  a timed out path drops out of the fused output,
+	// and event timing mode doesn't report individual hits.
+	float_t paced = paced_rate();
+	uint8_t i;
+	filter_tune( &s_filter, rate_update( &s_filter_rate, paced ) );
+	for( i = 0; i < FLOW_INSTANCE_COUNT; i++ )
+	{
+		flow_instance_t *p_instance = &s_instance[i];
+		if( !p_instance->present )
+			continue;
+		filter_q31_tune( &p_instance->tof_filter, rate_update( &p_instance->tof_rate, paced ) );
+		filter_bank_tune( &p_instance->hit_filter, rate_update( &p_instance->hit_rate, paced ) );
+	}
+}
+
+static void process_sample( const sample_t *p_sample )
+{
+	flow_instance_t *p_instance = &s_instance[p_sample->instance];
+	bool primary = p_instance == &s_instance[0];
+	uint8_t hitcount = p_instance->hitcount;
+	uint16_t status = p_sample->status;
 
-		float_t up[MAX3510X_MAX_HITCOUNT];
-		float_t down[MAX3510X_MAX_HITCOUNT];
-		for(i=0;i<s_hitcount;i++)
+	// temperature measurements take up time between flow samples too
+	p_instance->tof_interval += p_sample->time;
+	if( status & (MAX3510X_REG_INTERRUPT_STATUS_TOF|MAX3510X_REG_INTERRUPT_STATUS_TOF_EVTMG) )
+	{
+		fixed_tof_t tof;
+		fixed_tof( &tof, &p_sample->tof, hitcount );
+		if( primary && !(status & MAX3510X_REG_INTERRUPT_STATUS_TOF_EVTMG) )
+		{
+			// the TDC only applies its own calibration in event timing mode
+			fixed_tof_scale( &tof, calibration_scale(), hitcount );
+			autotune_threshold( &p_sample->tof, p_sample->cmd != flow_seq_cmd_tof_down, p_sample->cmd != flow_seq_cmd_tof_up );
+			if( p_sample->cmd == flow_seq_cmd_tof_diff )
+				autotune_window( &tof, p_instance->hitwaves, hitcount );
+#ifdef MAX35104
+			autotune_agc( &p_sample->tof, p_sample->cmd != flow_seq_cmd_tof_down, p_sample->cmd != flow_seq_cmd_tof_up );
+#endif
+		}
+		if( p_sample->cmd != flow_seq_cmd_tof_down )
+			wave_track( p_instance, &p_instance->wave_track[0], &tof.up );
+		if( p_sample->cmd != flow_seq_cmd_tof_up )
+			wave_track( p_instance, &p_instance->wave_track[1], &tof.down );
+		if( p_sample->cmd == flow_seq_cmd_tof_diff && !(status & MAX3510X_REG_INTERRUPT_STATUS_TOF_EVTMG) )
+		{
+			fixed_t hits[2*MAX3510X_MAX_HITCOUNT];
+			uint8_t i;
+			for( i = 0; i < MAX3510X_MAX_HITCOUNT; i++ )
+			{
+				hits[i] = i < hitcount ? tof.up.hit[i] : 0;
+				hits[MAX3510X_MAX_HITCOUNT+i] = i < hitcount ? tof.down.hit[i] : 0;
+			}
+			filter_bank_sample( &p_instance->hit_filter, hits );
+			p_instance->hit_rate.count++;
+		}
+		if( status & MAX3510X_REG_INTERRUPT_STATUS_TOF_EVTMG )
+		{
+			// event timing mode:  the hit registers hold the last cycle, but the difference
+			// is the TDC's average over the TDM cycles.
+			tof.tof_diff = fixed_from_max3510x( &p_sample->tof.tof_diff_ave );
+		}
+		else
 		{
-			up[i] = max3510x_fixed_to_float( &tof_fixed.up.hit[i] );
-			down[i] = max3510x_fixed_to_float( &tof_fixed.down.hit[i] );
+			tof.tof_diff = tof.up.average - tof.down.average;
 		}
-		s_last_sample_time = board_elapsed_time( s_last_sample_time, &t );
-		start_next_measurement( false );
-		uui_report_results(&up[0], &down[0], t, s_hitcount, 0 );
+		if( p_sample->cmd == flow_seq_cmd_tof_diff &&
+			!( (status & MAX3510X_REG_INTERRUPT_STATUS_TOF_EVTMG) && !MAX3510X_ENDIAN(p_sample->tof.tof_cycle_count) ) )
+		{
+			// single direction measurements don't carry a flow, and neither does
+			// an event timing cycle in which every measurement failed.
+			if( primary && !(status & MAX3510X_REG_INTERRUPT_STATUS_TOF_EVTMG) )
+				sweep_sample( &tof, &p_sample->tof, p_instance->hitwaves, hitcount );
+			tof.tof_diff = zero_correct( p_sample->instance, tof.tof_diff );
+			tof.tof_diff = hampel_sample( p_sample->instance, tof.tof_diff );
+			filter_q31_push( &p_instance->tof_filter, tof.tof_diff );
+			p_instance->tof_rate.count++;
+			if( !flowbody_compute( p_sample->instance, &p_instance->flowbody_result, &tof, s_sos_method ) )
+			{
+				// the time carries over to the path's next good sample
+				if( fusion_fault( p_sample->instance ) )
+					filter_output();
+			}
+			else
+			{
+				if( fusion_sample( p_sample->instance, &p_instance->flowbody_result, p_instance->tof_interval ) )
+					filter_output();
+				p_instance->tof_interval = 0;
+			}
+		}
+		uui_report_results( &tof, p_sample->time, hitcount, p_sample->gain_slot );
 	}
-	if( status & MAX3510X_REG_INTERRUPT_STATUS_TEMP_EVTMG )
+	if( primary && (status & MAX3510X_REG_INTERRUPT_STATUS_CAL) )
 	{
-		max3510x_register7_t temp_regs;
-		max3510x_read_registers( NULL, MAX3510X_REG_TEMP_CYCLE_COUNT, (max3510x_register_t*)&temp_regs, sizeof(temp_regs) );
-		start_next_measurement(false);
-		float_t therm = max3510x_fixed_to_float((const max3510x_fixed_t*)&temp_regs.value[1]);
-		float_t ref = max3510x_fixed_to_float((const max3510x_fixed_t*)&temp_regs.value[5]);
-		float_t r = board_temp_sensor_resistance( therm, ref );
+		calibration_update( &p_sample->cal, p_instance->temperature );
 	}
-	else if( status & MAX3510X_REG_INTERRUPT_STATUS_TE )
+	if( status & (MAX3510X_REG_INTERRUPT_STATUS_TEMP_EVTMG|MAX3510X_REG_INTERRUPT_STATUS_TE) )
 	{
-		max3510x_register6_t temp_regs;
-		max3510x_read_registers( NULL, MAX3510X_REG_T1INT, (max3510x_register_t*)&temp_regs, sizeof(temp_regs) );
-		start_next_measurement(false);
-		float_t therm = max3510x_fixed_to_float((const max3510x_fixed_t*)&temp_regs.value[0]);
-		float_t ref = max3510x_fixed_to_float((const max3510x_fixed_t*)&temp_regs.value[4]);
-		float_t r = board_temp_sensor_resistance( therm, ref );
-		s_last_sample_time = board_elapsed_time( s_last_sample_time, &t );
+		float_t therm, ref;
+		if( status & MAX3510X_REG_INTERRUPT_STATUS_TEMP_EVTMG )
+		{
+			therm = max3510x_fixed_to_float((const max3510x_fixed_t*)&p_sample->temp_evtmg.value[1]);
+			ref = max3510x_fixed_to_float((const max3510x_fixed_t*)&p_sample->temp_evtmg.value[5]);
+		}
+		else
+		{
+			therm = max3510x_fixed_to_float((const max3510x_fixed_t*)&p_sample->temp.value[0]);
+			ref = max3510x_fixed_to_float((const max3510x_fixed_t*)&p_sample->temp.value[4]);
+		}
+		p_instance->temperature = temperature_convert( board_temp_sensor_resistance( therm, ref ) );
+		flowbody_set_temperature( p_instance->temperature );
+		uui_report_temp( p_instance->temperature );
 	}
+}
 
+static void process_flow( void )
+{
+	const sample_t *p_sample;
+	uint8_t i;
+	filter_rate_update();
+	while( (p_sample = queue_peek()) )
+	{
+		process_sample( p_sample );
+		queue_release();
+	}
+	// everything that arrived since the last pass is filtered as one block
+	filter_flush( &s_filter );
+	for( i = 0; i < FLOW_INSTANCE_COUNT; i++ )
+		filter_q31_flush( &s_instance[i].tof_filter );
 }
 
 
+static bool device_distinct( uint8_t ndx )
+{
+	// an extra instance needs a TDC of its own.  one left on the NULL default device, or
+	// sharing another's, would start and read back the same chip more than once.
+	uint8_t i;
+	if( !ndx )
+		return true;
+	if( !s_instance[ndx].device )
+		return false;
+	for( i = 0; i < ndx; i++ )
+	{
+		if( s_instance[i].present && s_instance[i].device == s_instance[ndx].device )
+			return false;
+	}
+	return true;
+}
+
 void flow_init(void)
 {
-	max3510x_reset(NULL);
-	max3510x_wait_for_reset_complete(NULL);
-	max3510x_registers_t *p_config = config_get_max3510x_regs();
-	max3510x_write_config(NULL, p_config);
+	uint8_t i;
+	for( i = 0; i < FLOW_INSTANCE_COUNT; i++ )
+		s_instance[i].present = device_distinct( i );
+	for( i = 0; i < FLOW_INSTANCE_COUNT; i++ )
+	{
+		max3510x_t device = s_instance[i].device;
+		if( !s_instance[i].present )
+			continue;
+		max3510x_reset(device);
+		max3510x_wait_for_reset_complete(device);
+		max3510x_registers_t *p_config = config_get_max3510x_regs(i);
+		max3510x_write_config(device, p_config);
 #ifdef MAX35104
-	if( (MAX3510X_REG_GET( AFE1_AFE_BP, MAX3510X_ENDIAN(p_config->max35104_registers.afe1) ) == MAX3510X_REG_AFE1_AFE_BP_DISABLED ) && 
-		(MAX3510X_REG_GET( AFE2_BP_BYPASS, MAX3510X_ENDIAN(p_config->max35104_registers.afe2) ) == MAX3510X_REG_AFE2_BP_BYPASS_DISABLED)  &&
-		(MAX3510X_REG_GET( TOF1_DPL, MAX3510X_ENDIAN(p_config->common.tof1) ) >= MAX3510X_REG_TOF1_DPL_1MHZ ) )
+		if( (MAX3510X_REG_GET( AFE1_AFE_BP, MAX3510X_ENDIAN(p_config->max35104_registers.afe1) ) == MAX3510X_REG_AFE1_AFE_BP_DISABLED ) &&
+			(MAX3510X_REG_GET( AFE2_BP_BYPASS, MAX3510X_ENDIAN(p_config->max35104_registers.afe2) ) == MAX3510X_REG_AFE2_BP_BYPASS_DISABLED)  &&
+			(MAX3510X_REG_GET( TOF1_DPL, MAX3510X_ENDIAN(p_config->common.tof1) ) >= MAX3510X_REG_TOF1_DPL_1MHZ ) )
+		{
+			// issue bandpass filter calibrate command only when necessary
+			max3510x_bandpass_calibrate(device);
+			board_wait_ms( 3 );	// wait for bandpass calibrate to complete.
+		}
+#endif
+	}
+	autotune_init();
+	fusion_init();
+	for( i = 0; i < FLOW_INSTANCE_COUNT; i++ )
 	{
-		// issue bandpass filter calibrate command only when necessary
-		max3510x_bandpass_calibrate(NULL);
-		board_wait_ms( 3 );	// wait for bandpass calibrate to complete.
-	}	
-#endif                                
-	start_next_measurement(true);
+		// a missing path never reports, so don't let fusion wait on it
+		if( !s_instance[i].present )
+			fusion_fault( i );
+	}
+	// designed for the configured rate until the measured rates come in
+	filter_init( &s_filter, flow_get_sampling_frequency() );
+	for( i = 0; i < FLOW_INSTANCE_COUNT; i++ )
+	{
+		filter_q31_init( &s_instance[i].tof_filter, flow_get_sampling_frequency() );
+		filter_bank_init( &s_instance[i].hit_filter, 2*MAX3510X_MAX_HITCOUNT, flow_get_sampling_frequency() );
+	}
+	start_all(true);
 }
 
-static bool timeout_check( uint16_t status )
+static bool timeout_check( flow_instance_t *p_instance, uint16_t status )
 {
 	// check for timeouts
 	bool timeout = false;
@@ -265,8 +874,15 @@ static bool timeout_check( uint16_t status )
 	{
 		if( status & MAX3510X_REG_INTERRUPT_STATUS_TOF )
 		{
-			// transducer possibly disconnected
+			// transducer possibly disconnected, or the signal has dropped below the T1 threshold
 			timeout = true;
+			if( p_instance == &s_instance[0] )
+			{
+				autotune_timeout();
+				sweep_timeout();
+			}
+			if( fusion_fault( p_instance - &s_instance[0] ) )
+				filter_output();
 			board_led( 0, true );
 		}
 		else
@@ -292,30 +908,164 @@ static bool timeout_check( uint16_t status )
 	return timeout;
 }
 
+static uint16_t interrupt_status( flow_instance_t *p_instance )
+{
+	// additional TDCs share the interrupt line with the default device, so they're polled
+	if( p_instance == &s_instance[0] )
+		return board_max3510x_interrupt_status();
+	return max3510x_read_register( p_instance->device, MAX3510X_REG_INTERRUPT_STATUS );
+}
+
+static void restore( flow_instance_t *p_instance )
+{
+	// put the receive path back to the saved settings in case tracking has walked it
+	// somewhere it can't recover from
+	uint8_t ndx = p_instance - &s_instance[0];
+	uint8_t options = recovery_get_options();
+	if( options & RECOVERY_OPTION_RESTORE )
+	{
+		max3510x_write_config( p_instance->device, config_get_max3510x_regs(ndx) );
+		if( !ndx )
+			autotune_init();
+	}
+#ifdef MAX35104
+	if( options & RECOVERY_OPTION_BANDPASS )
+	{
+		max3510x_bandpass_calibrate( p_instance->device );
+		board_wait_ms( 3 );	// wait for bandpass calibrate to complete.
+	}
+#endif
+}
+
+static void timeout_recover( flow_instance_t *p_instance )
+{
+	uint8_t path = p_instance - &s_instance[0];
+	recovery_action_t action;
+
+	recovery_count_timeout( path, p_instance->cursor.cmd );
+	p_instance->response_pending = false;
+	if( s_requested_flow_sampling_mode != flow_sampling_mode_invalid ||
+		(s_flow_sampling_mode != flow_sampling_mode_max && s_flow_sampling_mode != flow_sampling_mode_host) )
+	{
+		// a mode change is waiting, or the TDC is running its own sequence.  no retry or
+		// backoff happens, so none is charged to the recovery policy.
+		restart( p_instance );
+		return;
+	}
+	action = recovery_timeout( path, p_instance->cursor.cmd );
+	if( action == recovery_action_retry )
+	{
+		measurement_run( p_instance, p_instance->cursor.cmd );
+	}
+	else
+	{
+		if( action == recovery_action_restore )
+			restore( p_instance );
+		p_instance->holding = true;	// resumed from flow_event() once the backoff expires
+		p_instance->tick_pending = false;
+		clock_update();
+	}
+}
+
+static void service( flow_instance_t *p_instance, uint16_t status )
+{
+	if( timeout_check( p_instance, status ) )
+	{
+		timeout_recover( p_instance );
+	}
+	else if( s_flow_sampling_mode == flow_sampling_mode_idle )
+	{
+		p_instance->response_pending = false;
+		if( p_instance == &s_instance[0] )
+			uui_report_tof_temp(status);
+	}
+	else
+	{
+		readout( p_instance, status );
+	}
+}
 
 void flow_event( uint32_t event )
 {
+	uint8_t i;
+
 	if( event & BOARD_EVENT_SYSTICK )
 	{
 		if( s_flow_sampling_mode == flow_sampling_mode_host )
 		{
-			start_next_measurement(true);
+			s_trigger = board_timestamp();
+			for( i = 0; i < FLOW_INSTANCE_COUNT; i++ )
+			{
+				flow_instance_t *p_instance = &s_instance[i];
+				if( !p_instance->present || p_instance->holding )
+					continue;
+				p_instance->tick = s_trigger;
+				p_instance->tick_pending = true;
+				if( !p_instance->response_pending )
+					restart( p_instance );
+			}
 		}
 	}
 
 	if( event & BOARD_EVENT_MAX35104 )
 	{
-		uint16_t status = board_max3510x_interrupt_status();
-		s_response_pending = false;
-		if( timeout_check( status ) )
+		// round robin so one busy TDC can't starve the others of the bus
+		for( i = 0; i < FLOW_INSTANCE_COUNT; i++ )
 		{
-			start_next_measurement(false);
+			flow_instance_t *p_instance = &s_instance[(s_next_instance + i) % FLOW_INSTANCE_COUNT];
+			uint16_t status;
+			if( !p_instance->present )
+				continue;
+			readout_finish();
+			status = interrupt_status( p_instance );
+			if( status )
+				service( p_instance, status );
 		}
-		else
+		if( ++s_next_instance >= FLOW_INSTANCE_COUNT )
+			s_next_instance = 0;
+		if( s_p_readout )
+		{
+			// the samples already queued are converted and reported while the transfer runs.
+			// none of that touches the bus.
+			process_flow();
+			readout_finish();
+		}
+	}
+	for( i = 0; i < FLOW_INSTANCE_COUNT; i++ )
+	{
+		if( s_instance[i].holding && recovery_ready( i ) )
 		{
-			process_flow(status);
+			// in host mode the next tick restarts it
+			s_instance[i].holding = false;
+			if( s_flow_sampling_mode == flow_sampling_mode_max )
+				start_next_measurement( &s_instance[i], false );
+			clock_update();
 		}
 	}
+	process_flow();
+}
+
+void flow_readout_complete( void )
+{
+	// called from the board's SPI DMA completion interrupt
+	s_readout_complete = true;
+}
+
+void flow_set_device( uint8_t ndx, max3510x_t device )
+{
+	// must be called before flow_init().  instance 0 defaults to the NULL device.
+	if( ndx < FLOW_INSTANCE_COUNT )
+		s_instance[ndx].device = device;
+}
+
+bool flow_path_present( uint8_t ndx )
+{
+	return ndx < FLOW_INSTANCE_COUNT && s_instance[ndx].present;
+}
+
+max3510x_t flow_get_device( uint8_t ndx )
+{
+	return ndx < FLOW_INSTANCE_COUNT ? s_instance[ndx].device : NULL;
 }
 
 flow_sampling_mode_t flow_get_sampling_mode( void )
@@ -339,14 +1089,14 @@ float_t flow_get_sampling_frequency( void )
 
 void flow_set_sampling_mode( flow_sampling_mode_t mode )
 {
-	if( s_response_pending )
+	if( response_pending() )
 	{
 		s_requested_flow_sampling_mode = mode;
 	}
 	else
 	{
 		s_flow_sampling_mode = mode;
-		start_next_measurement(true);
+		start_all(true);
 	}
 }
 
@@ -363,7 +1113,7 @@ flow_sos_method_t flow_get_sos_method( void )
 void flow_set_tof_temp( int16_t tof_temp )
 {
 	s_tof_temp = tof_temp;
-	s_tof_temp_count = 0;
+	sequence_from_tof_temp( tof_temp );
 }
 
 int16_t flow_get_tof_temp( void )
@@ -380,3 +1130,138 @@ void flow_set_event_timing_mode( max3510x_event_timing_mode_t mode )
 {
 	s_event_timing_mode = mode;
 }
+
+uint32_t flow_get_queue_overflow( void )
+{
+	return s_queue.overflow;
+}
+
+uint8_t flow_get_queue_high_water( void )
+{
+	return s_queue.high_water;
+}
+
+void flow_clear_queue_stats( void )
+{
+	s_queue.overflow = 0;
+	s_queue.high_water = 0;
+}
+
+const struct _flowbody_result_t * flow_get_result( void )
+{
+	return fusion_result();
+}
+
+const struct _flowbody_result_t * flow_get_path_result( uint8_t ndx )
+{
+	return ndx < FLOW_INSTANCE_COUNT ? &s_instance[ndx].flowbody_result : NULL;
+}
+
+float_t flow_get_filtered_flow( void )
+{
+	return s_filter.output;
+}
+
+uint8_t flow_get_filtered_hits( uint8_t ndx, const fixed_t **pp_up, const fixed_t **pp_down )
+{
+	// returns the hitcount
+	if( ndx >= FLOW_INSTANCE_COUNT )
+		return 0;
+	*pp_up = &s_instance[ndx].hit_filter.output[0];
+	*pp_down = &s_instance[ndx].hit_filter.output[MAX3510X_MAX_HITCOUNT];
+	return s_instance[ndx].hitcount;
+}
+
+fixed_t flow_get_filtered_tof_diff( uint8_t ndx )
+{
+	return ndx < FLOW_INSTANCE_COUNT ? s_instance[ndx].tof_filter.output : 0;
+}
+
+float_t flow_get_temperature( void )
+{
+	return s_instance[0].temperature;
+}
+
+bool flow_set_sequence( const flow_seq_slot_t *p_slot, uint8_t count )
+{
+	// an empty sequence reverts to the tof_temp pattern.  host mode paces the sequence with
+	// its high priority slots, so there has to be at least one.
+	uint8_t i;
+	bool paced = false;
+	if( count > FLOW_SEQ_MAX_SLOTS )
+		return false;
+	for( i = 0; i < count; i++ )
+	{
+		if( p_slot[i].cmd > flow_seq_cmd_cal || !p_slot[i].repeat || p_slot[i].priority > flow_seq_priority_low )
+			return false;
+		if( p_slot[i].priority == flow_seq_priority_high )
+			paced = true;
+	}
+	if( count && !paced )
+		return false;
+	if( !count )
+	{
+		sequence_from_tof_temp( s_tof_temp );
+		return true;
+	}
+	memcpy( s_sequence.slot, p_slot, count * sizeof(flow_seq_slot_t) );
+	s_sequence.count = count;
+	sequence_rewind_all();
+	return true;
+}
+
+uint8_t flow_get_sequence( flow_seq_slot_t *p_slot )
+{
+	memcpy( p_slot, s_sequence.slot, s_sequence.count * sizeof(flow_seq_slot_t) );
+	return s_sequence.count;
+}
+
+uint32_t flow_get_slips( uint8_t direction )
+{
+	return s_instance[0].wave_track[direction ? 1 : 0].slips;
+}
+
+void flow_clear_slips( void )
+{
+	uint8_t i;
+	for( i = 0; i < FLOW_INSTANCE_COUNT; i++ )
+	{
+		s_instance[i].wave_track[0].slips = 0;
+		s_instance[i].wave_track[1].slips = 0;
+	}
+}
+
+static void sweep_begin( flow_sampling_mode_t mode )
+{
+	// sweeps run in max mode, then go back to the mode they were started from
+	if( s_sweep_restore_mode == flow_sampling_mode_invalid )
+		s_sweep_restore_mode = mode;
+	flow_set_sampling_mode( flow_sampling_mode_max );
+}
+
+bool flow_sweep_param( sweep_set_t p_set, float_t start, float_t stop, float_t step, uint8_t count )
+{
+	flow_sampling_mode_t mode = flow_get_sampling_mode();
+	if( !sweep_start_param( p_set, start, stop, step, count ) )
+		return false;
+	sweep_begin( mode );
+	return true;
+}
+
+#ifdef MAX35104
+
+bool flow_sweep_bandpass( uint8_t f0_step, uint8_t count, bool lowq )
+{
+	flow_sampling_mode_t mode = flow_get_sampling_mode();
+	if( !sweep_start_bandpass( f0_step, count, lowq ) )
+		return false;
+	sweep_begin( mode );
+	return true;
+}
+
+#endif
+
+void flow_sweep_abort( void )
+{
+	sweep_abort();
+}
@@ -31,7 +31,15 @@
  *
  ******************************************************************************/
  
+#ifndef __FLOW_H__
+#define __FLOW_H__
+
 #include "max3510x.h"
+#include "sweep.h"
+
+#ifndef FLOW_INSTANCE_COUNT
+#define FLOW_INSTANCE_COUNT	1	// number of TDCs sharing the SPI bus and interrupt line
+#endif
 
 void flow_init(void);
 void flow_event( uint32_t event );
@@ -53,6 +61,33 @@ typedef enum _flow_sampling_mode_t
 }
 flow_sampling_mode_t;
 
+typedef enum _flow_seq_cmd_t
+{
+	flow_seq_cmd_tof_diff,
+	flow_seq_cmd_tof_up,
+	flow_seq_cmd_tof_down,
+	flow_seq_cmd_temp,
+	flow_seq_cmd_cal
+}
+flow_seq_cmd_t;
+
+typedef enum _flow_seq_priority_t
+{
+	flow_seq_priority_high,		// paced by the host sampling clock
+	flow_seq_priority_low		// fills the time left over after a high priority slot
+}
+flow_seq_priority_t;
+
+typedef struct _flow_seq_slot_t
+{
+	uint8_t		cmd;		// flow_seq_cmd_t
+	uint8_t		repeat;
+	uint8_t		priority;	// flow_seq_priority_t
+}
+flow_seq_slot_t;
+
+#define FLOW_SEQ_MAX_SLOTS	8
+
 void flow_set_sampling_mode( flow_sampling_mode_t mode );
 void flow_set_sampling_frequency( float_t sampling_frequency );
 float_t flow_get_sampling_frequency(void);
@@ -65,3 +100,33 @@ int16_t flow_get_tof_temp( void );
 void flow_set_tof_temp( int16_t tof_temp );
 max3510x_event_timing_mode_t flow_get_event_timing_mode( void );
 void flow_set_event_timing_mode( max3510x_event_timing_mode_t mode );
+uint32_t flow_get_queue_overflow( void );
+uint8_t flow_get_queue_high_water( void );
+void flow_clear_queue_stats( void );
+const struct _flowbody_result_t * flow_get_result( void );
+const struct _flowbody_result_t * flow_get_path_result( uint8_t ndx );
+float_t flow_get_temperature( void );
+float_t flow_get_filtered_flow( void );
+fixed_t flow_get_filtered_tof_diff( uint8_t ndx );
+uint8_t flow_get_filtered_hits( uint8_t ndx, const fixed_t **pp_up, const fixed_t **pp_down );
+bool flow_set_sequence( const flow_seq_slot_t *p_slot, uint8_t count );
+uint8_t flow_get_sequence( flow_seq_slot_t *p_slot );
+uint32_t flow_get_slips( uint8_t direction );
+void flow_clear_slips( void );
+bool flow_sweep_param( sweep_set_t p_set, float_t start, float_t stop, float_t step, uint8_t count );
+#ifdef MAX35104
+bool flow_sweep_bandpass( uint8_t f0_step, uint8_t count, bool lowq );
+#endif
+void flow_sweep_abort( void );
+// Board code registers each additional TDC before flow_init() and routes its interrupt to
+// BOARD_EVENT_MAX35104.  Instances without a device of their own are left out.
+// A board with a DMA capable SPI can provide board_max3510x_read_async():  start a burst read
+// of size bytes from reg into p_dst and return true, then call flow_readout_complete() from
+// the completion interrupt.  Without it, results are read with blocking transfers.
+bool board_max3510x_read_async( max3510x_t device, uint8_t reg, void *p_dst, uint16_t size );
+void flow_readout_complete( void );
+void flow_set_device( uint8_t ndx, max3510x_t device );
+bool flow_path_present( uint8_t ndx );
+max3510x_t flow_get_device( uint8_t ndx );
+
+#endif
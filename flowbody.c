@@ -0,0 +1,163 @@
+/*******************************************************************************
+ * Copyright (C) 2017 Maxim Integrated Products, Inc., All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL MAXIM INTEGRATED BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Except as contained in this notice, the name of Maxim Integrated
+ * Products, Inc. shall not be used except as stated in the Maxim Integrated
+ * Products, Inc. Branding Policy.
+ *
+ * The mere transfer of this software does not imply any licenses
+ * of trade secrets, proprietary technology, copyrights, patents,
+ * trademarks, maskwork rights, or any other form of intellectual
+ * property whatsoever. Maxim Integrated Products, Inc. retains all
+ * ownership rights.
+ *
+ ******************************************************************************/
+
+#include "global.h"
+#include "flowbody.h"
+
+// Transit time flow computation.  t_up is measured against the flow, t_down with it.
+//
+//   c = L/2 * ( 1/t_down + 1/t_up )
+//   v = L/(2cos(a)) * ( 1/t_down - 1/t_up ) = L/(2cos(a)) * (t_up - t_down) / (t_up * t_down)
+//
+// Times arrive as Q16.16 counts of the 4MHz period, so the scaling from counts to seconds is
+// folded into the constants below.  Everything that does not change from sample to sample is
+// recomputed only when the geometry or temperature changes.
+//
+// Each acoustic path has its own length and angle:  the chords of a multi-path body differ.
+// The cross section belongs to the body, so it's shared.
+
+#define IDEAL_AIR_K		(1.4f * 8.314462f / 0.0289647f)	// gamma*R/M for dry air, (m/s)^2/K
+
+typedef struct _path_t
+{
+	float_t	length;				// transducer face to face distance (m)
+	float_t	angle;				// angle between the acoustic path and the pipe axis (degrees)
+	float_t	sos_scale;
+	float_t	velocity_scale;
+	float_t	air_velocity_scale;
+	bool	valid;
+}
+path_t;
+
+static path_t s_path[FLOW_INSTANCE_COUNT];	// set from the configuration before the first sample
+static float_t s_area = 3.1416e-4f;	// pipe cross section (m^2)
+static float_t s_temperature = 293.15f;
+static float_t s_air_sos_squared;
+
+static void update( path_t *p_path )
+{
+	const float_t counts_per_second = 1.0f / FIXED_TO_SECONDS;
+	float_t cos_angle = cosf( p_path->angle * (3.14159265f / 180.0f) );
+
+	p_path->sos_scale = 0.5f * p_path->length * counts_per_second;
+	p_path->velocity_scale = p_path->length * counts_per_second / ( 2.0f * cos_angle );
+
+	// ideal gas:  c^2 = gamma*R*T/M, and v ~= c^2 * (t_up - t_down) / (2*L*cos(a))
+	s_air_sos_squared = IDEAL_AIR_K * s_temperature;
+	p_path->air_velocity_scale = p_path->length > 0 ?
+		s_air_sos_squared * FIXED_TO_SECONDS / ( 2.0f * p_path->length * cos_angle ) : 0;
+	p_path->valid = true;
+}
+
+static void invalidate( void )
+{
+	uint8_t i;
+	for( i = 0; i < FLOW_INSTANCE_COUNT; i++ )
+		s_path[i].valid = false;
+}
+
+bool flowbody_compute( uint8_t path, flowbody_result_t *p_result, const fixed_tof_t *p_tof, flow_sos_method_t method )
+{
+	// returns false, leaving p_result alone, for a sample with no usable transit times, such
+	// as an all zero readout after a partial TOF
+	path_t *p_path;
+	if( path >= FLOW_INSTANCE_COUNT || p_tof->up.average <= 0 || p_tof->down.average <= 0 )
+		return false;
+	p_path = &s_path[path];
+	if( !p_path->valid )
+		update( p_path );
+
+	if( method == flow_sos_method_ideal_air )
+	{
+		p_result->sos = sqrtf( s_air_sos_squared );
+		p_result->velocity = p_path->air_velocity_scale * (float_t)p_tof->tof_diff;
+	}
+	else
+	{
+		// one divide per sample
+		float_t up = (float_t)p_tof->up.average;
+		float_t down = (float_t)p_tof->down.average;
+		float_t r = 1.0f / ( up * down );
+		p_result->sos = p_path->sos_scale * ( up + down ) * r;
+		p_result->velocity = p_path->velocity_scale * (float_t)p_tof->tof_diff * r;
+	}
+	p_result->flow = p_result->velocity * s_area;
+	return true;
+}
+
+void flowbody_set_path_length( uint8_t path, float_t length )
+{
+	if( path >= FLOW_INSTANCE_COUNT )
+		return;
+	s_path[path].length = length;
+	s_path[path].valid = false;
+}
+
+float_t flowbody_get_path_length( uint8_t path )
+{
+	return path < FLOW_INSTANCE_COUNT ? s_path[path].length : 0;
+}
+
+void flowbody_set_path_angle( uint8_t path, float_t degrees )
+{
+	if( path >= FLOW_INSTANCE_COUNT )
+		return;
+	s_path[path].angle = degrees;
+	s_path[path].valid = false;
+}
+
+float_t flowbody_get_path_angle( uint8_t path )
+{
+	return path < FLOW_INSTANCE_COUNT ? s_path[path].angle : 0;
+}
+
+void flowbody_set_area( float_t area )
+{
+	s_area = area;
+}
+
+float_t flowbody_get_area( void )
+{
+	return s_area;
+}
+
+void flowbody_set_temperature( float_t temp_K )
+{
+	s_temperature = temp_K;
+	invalidate();
+}
+
+float_t flowbody_get_temperature( void )
+{
+	return s_temperature;
+}
@@ -0,0 +1,59 @@
+/*******************************************************************************
+ * Copyright (C) 2017 Maxim Integrated Products, Inc., All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL MAXIM INTEGRATED BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Except as contained in this notice, the name of Maxim Integrated
+ * Products, Inc. shall not be used except as stated in the Maxim Integrated
+ * Products, Inc. Branding Policy.
+ *
+ * The mere transfer of this software does not imply any licenses
+ * of trade secrets, proprietary technology, copyrights, patents,
+ * trademarks, maskwork rights, or any other form of intellectual
+ * property whatsoever. Maxim Integrated Products, Inc. retains all
+ * ownership rights.
+ *
+ ******************************************************************************/
+
+#ifndef __FLOWBODY_H__
+#define __FLOWBODY_H__
+
+#include "flow.h"
+#include "fixed.h"
+
+typedef struct _flowbody_result_t
+{
+	float_t	sos;		// speed of sound (m/s)
+	float_t	velocity;	// axial flow velocity (m/s)
+	float_t	flow;		// volumetric flow (m^3/s)
+}
+flowbody_result_t;
+
+bool flowbody_compute( uint8_t path, flowbody_result_t *p_result, const fixed_tof_t *p_tof, flow_sos_method_t method );
+
+void flowbody_set_path_length( uint8_t path, float_t length );
+float_t flowbody_get_path_length( uint8_t path );
+void flowbody_set_path_angle( uint8_t path, float_t degrees );
+float_t flowbody_get_path_angle( uint8_t path );
+void flowbody_set_area( float_t area );
+float_t flowbody_get_area( void );
+void flowbody_set_temperature( float_t temp_K );
+float_t flowbody_get_temperature( void );
+
+#endif
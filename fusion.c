@@ -0,0 +1,190 @@
+/*******************************************************************************
+ * Copyright (C) 2017 Maxim Integrated Products, Inc., All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL MAXIM INTEGRATED BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Except as contained in this notice, the name of Maxim Integrated
+ * Products, Inc. shall not be used except as stated in the Maxim Integrated
+ * Products, Inc. Branding Policy.
+ *
+ * The mere transfer of this software does not imply any licenses
+ * of trade secrets, proprietary technology, copyrights, patents,
+ * trademarks, maskwork rights, or any other form of intellectual
+ * property whatsoever. Maxim Integrated Products, Inc. retains all
+ * ownership rights.
+ *
+ ******************************************************************************/
+
+
+#include "global.h"
+#include "fusion.h"
+#include "totalizer.h"
+
+#if FLOW_INSTANCE_COUNT > 8
+#error "the path mask only covers eight paths"
+#endif
+
+// Combines the per-path results of a multi-path (chordal) meter into one flow.
+//
+//   v = sum( w[i] * v[i] ) / sum( w[i] )
+//
+// over the paths that are both enabled by the mask and healthy.  w[] are the path
+// integration weights (Gauss-Jacobi, Gauss-Legendre, OWICS, ...) for the chord positions
+// of the body in use.  Each path holds at most one pending sample;  a newer sample from a
+// fast path replaces the pending one, so a result is produced once every contributing
+// path has reported, i.e. at the rate of the slowest path.  A path that times out is
+// dropped from the sum, and the remaining weights renormalised, until it reports again.
+
+typedef struct _path_t
+{
+	float_t	weight;
+	float_t	velocity;
+	float_t	sos;
+	float_t	interval;		// time covered by the pending sample
+	bool	pending;
+	bool	healthy;
+}
+path_t;
+
+static path_t				s_path[FLOW_INSTANCE_COUNT];
+static uint8_t				s_mask = (uint8_t)((1UL<<FLOW_INSTANCE_COUNT)-1);
+static flowbody_result_t	s_result;
+
+static bool contributes( uint8_t path )
+{
+	return (s_mask & (1<<path)) && s_path[path].healthy && s_path[path].weight > 0;
+}
+
+static bool fuse( void )
+{
+	uint8_t i;
+	float_t weight = 0, velocity = 0, sos = 0, interval = 0;
+
+	for( i = 0; i < FLOW_INSTANCE_COUNT; i++ )
+	{
+		if( contributes(i) && !s_path[i].pending )
+			return false;		// still waiting on a slower path
+	}
+	for( i = 0; i < FLOW_INSTANCE_COUNT; i++ )
+	{
+		path_t *p_path = &s_path[i];
+		if( contributes(i) )
+		{
+			weight += p_path->weight;
+			velocity += p_path->weight * p_path->velocity;
+			sos += p_path->weight * p_path->sos;
+			// the paths run concurrently, so the slowest one sets the period
+			if( p_path->interval > interval )
+				interval = p_path->interval;
+		}
+		p_path->pending = false;
+		p_path->interval = 0;
+	}
+	if( weight <= 0 )
+		return false;
+	s_result.velocity = velocity / weight;
+	s_result.sos = sos / weight;
+	s_result.flow = s_result.velocity * flowbody_get_area();
+	totalizer_sample( s_result.flow, interval );
+	return true;
+}
+
+void fusion_init( void )
+{
+	uint8_t i;
+	for( i = 0; i < FLOW_INSTANCE_COUNT; i++ )
+	{
+		s_path[i].pending = false;
+		s_path[i].interval = 0;
+		s_path[i].healthy = true;
+	}
+}
+
+bool fusion_sample( uint8_t path, const flowbody_result_t *p_result, float_t interval )
+{
+	// returns true when a new fused result is available
+	path_t *p_path;
+	if( path >= FLOW_INSTANCE_COUNT )
+		return false;
+	p_path = &s_path[path];
+	p_path->velocity = p_result->velocity;
+	p_path->sos = p_result->sos;
+	p_path->interval += interval;
+	p_path->pending = true;
+	p_path->healthy = true;
+	return fuse();
+}
+
+bool fusion_fault( uint8_t path )
+{
+	// drop the path until it reports again so the others aren't held up waiting on it
+	if( path >= FLOW_INSTANCE_COUNT )
+		return false;
+	s_path[path].healthy = false;
+	s_path[path].pending = false;
+	return fuse();
+}
+
+const flowbody_result_t * fusion_result( void )
+{
+	return &s_result;
+}
+
+bool fusion_set_weights( const float_t *p_weight, uint8_t count )
+{
+	uint8_t i;
+	if( count != FLOW_INSTANCE_COUNT )
+		return false;
+	for( i = 0; i < count; i++ )
+	{
+		if( p_weight[i] < 0 )
+			return false;
+	}
+	for( i = 0; i < count; i++ )
+		s_path[i].weight = p_weight[i];
+	return true;
+}
+
+void fusion_get_weights( float_t *p_weight )
+{
+	uint8_t i;
+	for( i = 0; i < FLOW_INSTANCE_COUNT; i++ )
+		p_weight[i] = s_path[i].weight;
+}
+
+void fusion_set_mask( uint8_t mask )
+{
+	s_mask = mask & (uint8_t)((1UL<<FLOW_INSTANCE_COUNT)-1);
+}
+
+uint8_t fusion_get_mask( void )
+{
+	return s_mask;
+}
+
+uint8_t fusion_get_health( void )
+{
+	uint8_t i, health = 0;
+	for( i = 0; i < FLOW_INSTANCE_COUNT; i++ )
+	{
+		if( s_path[i].healthy )
+			health |= 1<<i;
+	}
+	return health;
+}
@@ -0,0 +1,267 @@
+/*******************************************************************************
+ * Copyright (C) 2017 Maxim Integrated Products, Inc., All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL MAXIM INTEGRATED BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Except as contained in this notice, the name of Maxim Integrated
+ * Products, Inc. shall not be used except as stated in the Maxim Integrated
+ * Products, Inc. Branding Policy.
+ *
+ * The mere transfer of this software does not imply any licenses
+ * of trade secrets, proprietary technology, copyrights, patents,
+ * trademarks, maskwork rights, or any other form of intellectual
+ * property whatsoever. Maxim Integrated Products, Inc. retains all
+ * ownership rights.
+ *
+ ******************************************************************************/
+
+
+#include "global.h"
+#include "hampel.h"
+#include "flow.h"
+
+// Hampel outlier rejection for tof_diff.  A sample further than threshold * 1.4826 * MAD from
+// the median of the preceding window is replaced by that median.  1.4826 scales the MAD to a
+// standard deviation for gaussian noise.  The test is causal, so it adds no latency, and the
+// raw sample still enters the window:  a genuine step in flow is accepted once it makes up
+// half the window.
+//
+// The median is kept with an indexed pair of heaps over the window's ring:  a max heap below
+// the median and a min heap above it.  Each sample replaces the oldest value in place and is
+// sifted in O(log N).  The MAD is the median of a second window holding each sample's
+// distance from the median at the time it arrived, so it's kept the same way rather than
+// rebuilt from the current median every sample.
+
+#define MAD_SCALE	1.4826f
+
+typedef struct _median_t
+{
+	fixed_t	data[HAMPEL_MAX_WINDOW];	// the window, in arrival order
+	int8_t	pos[HAMPEL_MAX_WINDOW];		// heap position of each data[] entry
+	uint8_t	heap[HAMPEL_MAX_WINDOW];	// data[] index at each heap position, median in the middle
+	uint8_t	size;
+	uint8_t	count;
+	uint8_t	ndx;						// oldest entry
+}
+median_t;
+
+typedef struct _path_t
+{
+	median_t	value;
+	median_t	deviation;
+	uint32_t	rejected;
+}
+path_t;
+
+static path_t	s_path[FLOW_INSTANCE_COUNT];
+static uint8_t	s_window = 7;			// 0 disables
+static float_t	s_threshold = 3.0f;
+
+// heap positions run from -size/2 (max heap) through 0 (median) to size/2 (min heap).
+// children of i are 2i and 2i+1 on the min side, 2i and 2i-1 on the max side.
+
+#define HEAP(m,i)	(m)->heap[(i) + (m)->size/2]
+#define MIN_COUNT(m)	(((m)->count-1)/2)
+#define MAX_COUNT(m)	((m)->count/2)
+
+static bool less( const median_t *p_m, int8_t i, int8_t j )
+{
+	return p_m->data[HEAP(p_m,i)] < p_m->data[HEAP(p_m,j)];
+}
+
+static bool exchange( median_t *p_m, int8_t i, int8_t j )
+{
+	uint8_t t = HEAP(p_m,i);
+	HEAP(p_m,i) = HEAP(p_m,j);
+	HEAP(p_m,j) = t;
+	p_m->pos[HEAP(p_m,i)] = i;
+	p_m->pos[HEAP(p_m,j)] = j;
+	return true;
+}
+
+static bool order( median_t *p_m, int8_t i, int8_t j )
+{
+	// swaps i and j if i < j
+	return less( p_m, i, j ) && exchange( p_m, i, j );
+}
+
+static void min_sort_down( median_t *p_m, int8_t i )
+{
+	for( ; i <= MIN_COUNT(p_m); i *= 2 )
+	{
+		if( i > 1 && i < MIN_COUNT(p_m) && less( p_m, i+1, i ) )
+			++i;
+		if( !order( p_m, i, i/2 ) )
+			break;
+	}
+}
+
+static void max_sort_down( median_t *p_m, int8_t i )
+{
+	for( ; i >= -MAX_COUNT(p_m); i *= 2 )
+	{
+		if( i < -1 && i > -MAX_COUNT(p_m) && less( p_m, i, i-1 ) )
+			--i;
+		if( !order( p_m, i/2, i ) )
+			break;
+	}
+}
+
+static bool min_sort_up( median_t *p_m, int8_t i )
+{
+	// returns true if the item reached the median
+	while( i > 0 && order( p_m, i, i/2 ) )
+		i /= 2;
+	return i == 0;
+}
+
+static bool max_sort_up( median_t *p_m, int8_t i )
+{
+	while( i < 0 && order( p_m, i/2, i ) )
+		i /= 2;
+	return i == 0;
+}
+
+static void median_init( median_t *p_m, uint8_t size )
+{
+	// initial fill pattern:  median, max, min, max, min ...
+	uint8_t k;
+	memset( p_m, 0, sizeof(median_t) );
+	p_m->size = size;
+	for( k = 0; k < size; k++ )
+	{
+		p_m->pos[k] = (int8_t)( ((k+1)/2) * ( (k & 1) ? -1 : 1 ) );
+		HEAP(p_m,p_m->pos[k]) = k;
+	}
+}
+
+static void median_insert( median_t *p_m, fixed_t v )
+{
+	bool fresh = p_m->count < p_m->size;
+	int8_t p = p_m->pos[p_m->ndx];
+	fixed_t old = p_m->data[p_m->ndx];
+	p_m->data[p_m->ndx] = v;
+	if( ++p_m->ndx >= p_m->size )
+		p_m->ndx = 0;
+	if( fresh )
+		p_m->count++;
+	if( p > 0 )
+	{
+		// replaced an item in the min heap
+		if( !fresh && old < v )
+			min_sort_down( p_m, p*2 );
+		else if( min_sort_up( p_m, p ) )
+			max_sort_down( p_m, -1 );
+	}
+	else if( p < 0 )
+	{
+		if( !fresh && v < old )
+			max_sort_down( p_m, p*2 );
+		else if( max_sort_up( p_m, p ) )
+			min_sort_down( p_m, 1 );
+	}
+	else
+	{
+		// replaced the median
+		if( MAX_COUNT(p_m) )
+			max_sort_down( p_m, -1 );
+		if( MIN_COUNT(p_m) )
+			min_sort_down( p_m, 1 );
+	}
+}
+
+static fixed_t median( const median_t *p_m )
+{
+	// only called on a full window, and the size is odd
+	return p_m->data[HEAP(p_m,0)];
+}
+
+static void reset( void )
+{
+	uint8_t i;
+	for( i = 0; i < FLOW_INSTANCE_COUNT; i++ )
+	{
+		median_init( &s_path[i].value, s_window );
+		median_init( &s_path[i].deviation, s_window );
+	}
+}
+
+fixed_t hampel_sample( uint8_t path, fixed_t x )
+{
+	path_t *p_path;
+	fixed_t out = x;
+	if( !s_window || path >= FLOW_INSTANCE_COUNT )
+		return x;
+	p_path = &s_path[path];
+	if( !p_path->value.size )
+		reset();
+	if( p_path->value.count == s_window )
+	{
+		fixed_t med = median( &p_path->value );
+		fixed_t dev = x > med ? x - med : med - x;
+		if( p_path->deviation.count == s_window )
+		{
+			fixed_t mad = median( &p_path->deviation );
+			if( mad < 1 )
+				mad = 1;	// quantized, quiet data would otherwise reject any change at all
+			if( (float_t)dev > s_threshold * MAD_SCALE * (float_t)mad )
+			{
+				out = med;
+				p_path->rejected++;
+			}
+		}
+		median_insert( &p_path->deviation, dev );
+	}
+	median_insert( &p_path->value, x );
+	return out;
+}
+
+bool hampel_set_window( uint8_t window, float_t threshold )
+{
+	// an odd window keeps the median a single sample
+	if( window > HAMPEL_MAX_WINDOW || ( window && ( window < 3 || !(window & 1) ) ) || threshold <= 0 )
+		return false;
+	s_window = window;
+	s_threshold = threshold;
+	if( s_window )
+		reset();
+	return true;
+}
+
+uint8_t hampel_get_window( void )
+{
+	return s_window;
+}
+
+float_t hampel_get_threshold( void )
+{
+	return s_threshold;
+}
+
+uint32_t hampel_get_rejected( uint8_t path )
+{
+	return path < FLOW_INSTANCE_COUNT ? s_path[path].rejected : 0;
+}
+
+void hampel_clear_rejected( void )
+{
+	uint8_t i;
+	for( i = 0; i < FLOW_INSTANCE_COUNT; i++ )
+		s_path[i].rejected = 0;
+}
@@ -0,0 +1,186 @@
+/*******************************************************************************
+ * Copyright (C) 2017 Maxim Integrated Products, Inc., All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL MAXIM INTEGRATED BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Except as contained in this notice, the name of Maxim Integrated
+ * Products, Inc. shall not be used except as stated in the Maxim Integrated
+ * Products, Inc. Branding Policy.
+ *
+ * The mere transfer of this software does not imply any licenses
+ * of trade secrets, proprietary technology, copyrights, patents,
+ * trademarks, maskwork rights, or any other form of intellectual
+ * property whatsoever. Maxim Integrated Products, Inc. retains all
+ * ownership rights.
+ *
+ ******************************************************************************/
+
+
+#include "global.h"
+#include "recovery.h"
+#include "flow.h"
+#include "board.h"
+
+// Timeout recovery policy.  Intermittent signal loss (a bubble, a pressure transient) is
+// ridden out with immediate retries so the good sample rate barely moves.  Once a path
+// has failed more than the retry budget in a row it is held off for a backoff period that
+// doubles with every further failure, up to BACKOFF_MAX, so a dead path doesn't spin the
+// bus and the processor at full rate.  The first failure past the budget can also restore
+// the receive path settings.  Runs are kept per measurement type and only a good sample
+// of the same type ends one, so a temperature measurement that keeps working doesn't
+// reset the budget and backoff of a TOF that keeps failing.
+
+#define BACKOFF_MIN		0.01f	// seconds
+#define BACKOFF_MAX		1.0f
+#define KIND_COUNT		(flow_seq_cmd_cal+1)
+
+typedef struct _path_t
+{
+	uint8_t				failures[KIND_COUNT];	// consecutive timeouts, by flow_seq_cmd_t
+	float_t				backoff[KIND_COUNT];	// hold off period of each run
+	bool				holding;
+	float_t				hold;					// current hold off period
+	uint32_t			timestamp;				// start of the hold off
+	recovery_stats_t	stats;
+}
+path_t;
+
+static path_t	s_path[FLOW_INSTANCE_COUNT];
+static uint8_t	s_budget = 2;
+static uint8_t	s_options;
+
+void recovery_count_timeout( uint8_t path, uint8_t cmd )
+{
+	// every timeout is counted, whether or not the sampling mode acts on it
+	path_t *p_path;
+	if( path >= FLOW_INSTANCE_COUNT )
+		return;
+	p_path = &s_path[path];
+	switch( cmd )
+	{
+		case flow_seq_cmd_tof_up:
+			p_path->stats.timeouts_up++;
+			break;
+		case flow_seq_cmd_tof_down:
+			p_path->stats.timeouts_down++;
+			break;
+		case flow_seq_cmd_temp:
+			p_path->stats.timeouts_temp++;
+			break;
+		case flow_seq_cmd_cal:
+			p_path->stats.timeouts_cal++;
+			break;
+		default:
+			p_path->stats.timeouts_diff++;
+			break;
+	}
+}
+
+recovery_action_t recovery_timeout( uint8_t path, uint8_t cmd )
+{
+	path_t *p_path;
+	uint8_t *p_failures;
+	float_t *p_backoff;
+	if( path >= FLOW_INSTANCE_COUNT || cmd >= KIND_COUNT )
+		return recovery_action_retry;
+	p_path = &s_path[path];
+	p_failures = &p_path->failures[cmd];
+	p_backoff = &p_path->backoff[cmd];
+	if( *p_failures < 255 )
+		(*p_failures)++;
+	if( *p_failures <= s_budget )
+	{
+		p_path->stats.retries++;
+		return recovery_action_retry;
+	}
+	if( *p_failures == s_budget + 1 )
+		*p_backoff = BACKOFF_MIN;
+	else if( *p_backoff < BACKOFF_MAX )
+		*p_backoff = *p_backoff * 2.0f > BACKOFF_MAX ? BACKOFF_MAX : *p_backoff * 2.0f;
+	p_path->holding = true;
+	p_path->hold = *p_backoff;
+	p_path->timestamp = board_timestamp();
+	p_path->stats.backoffs++;
+	if( *p_failures == s_budget + 1 && s_options )
+	{
+		p_path->stats.restores++;
+		return recovery_action_restore;
+	}
+	return recovery_action_backoff;
+}
+
+void recovery_success( uint8_t path, uint8_t cmd )
+{
+	path_t *p_path;
+	if( path >= FLOW_INSTANCE_COUNT || cmd >= KIND_COUNT )
+		return;
+	p_path = &s_path[path];
+	if( p_path->failures[cmd] )
+		p_path->stats.recoveries++;
+	p_path->failures[cmd] = 0;
+	p_path->holding = false;
+}
+
+bool recovery_ready( uint8_t path )
+{
+	float_t elapsed;
+	path_t *p_path;
+	if( path >= FLOW_INSTANCE_COUNT )
+		return true;
+	p_path = &s_path[path];
+	if( !p_path->holding )
+		return true;
+	board_elapsed_time( p_path->timestamp, &elapsed );
+	if( elapsed < p_path->hold )
+		return false;
+	p_path->holding = false;
+	return true;
+}
+
+void recovery_set_budget( uint8_t retries )
+{
+	s_budget = retries > 254 ? 254 : retries;
+}
+
+uint8_t recovery_get_budget( void )
+{
+	return s_budget;
+}
+
+void recovery_set_options( uint8_t options )
+{
+	s_options = options & (RECOVERY_OPTION_RESTORE|RECOVERY_OPTION_BANDPASS);
+}
+
+uint8_t recovery_get_options( void )
+{
+	return s_options;
+}
+
+const recovery_stats_t * recovery_get_stats( uint8_t path )
+{
+	return path < FLOW_INSTANCE_COUNT ? &s_path[path].stats : NULL;
+}
+
+void recovery_clear_stats( void )
+{
+	uint8_t i;
+	for( i = 0; i < FLOW_INSTANCE_COUNT; i++ )
+		memset( &s_path[i].stats, 0, sizeof(s_path[i].stats) );
+}
@@ -0,0 +1,77 @@
+/*******************************************************************************
+ * Copyright (C) 2017 Maxim Integrated Products, Inc., All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL MAXIM INTEGRATED BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Except as contained in this notice, the name of Maxim Integrated
+ * Products, Inc. shall not be used except as stated in the Maxim Integrated
+ * Products, Inc. Branding Policy.
+ *
+ * The mere transfer of this software does not imply any licenses
+ * of trade secrets, proprietary technology, copyrights, patents,
+ * trademarks, maskwork rights, or any other form of intellectual
+ * property whatsoever. Maxim Integrated Products, Inc. retains all
+ * ownership rights.
+ *
+ ******************************************************************************/
+
+
+#ifndef __RECOVERY_H__
+#define __RECOVERY_H__
+
+#include "global.h"
+
+typedef enum _recovery_action_t
+{
+	recovery_action_retry,		// reissue the failed measurement now
+	recovery_action_backoff,	// hold off until recovery_ready()
+	recovery_action_restore		// restore the receive path, then hold off
+}
+recovery_action_t;
+
+// options applied when the retry budget runs out
+#define RECOVERY_OPTION_RESTORE		0x01	// reload the saved threshold, window and gain
+#define RECOVERY_OPTION_BANDPASS	0x02	// rerun the bandpass calibration (MAX35104)
+
+typedef struct _recovery_stats_t
+{
+	uint32_t	timeouts_up;
+	uint32_t	timeouts_down;
+	uint32_t	timeouts_diff;		// tof_diff, either direction
+	uint32_t	timeouts_temp;
+	uint32_t	timeouts_cal;
+	uint32_t	retries;
+	uint32_t	backoffs;
+	uint32_t	restores;
+	uint32_t	recoveries;			// good samples that ended a run of their own kind's timeouts
+}
+recovery_stats_t;
+
+void recovery_count_timeout( uint8_t path, uint8_t cmd );
+recovery_action_t recovery_timeout( uint8_t path, uint8_t cmd );
+void recovery_success( uint8_t path, uint8_t cmd );
+bool recovery_ready( uint8_t path );
+void recovery_set_budget( uint8_t retries );
+uint8_t recovery_get_budget( void );
+void recovery_set_options( uint8_t options );
+uint8_t recovery_get_options( void );
+const recovery_stats_t * recovery_get_stats( uint8_t path );
+void recovery_clear_stats( void );
+
+#endif
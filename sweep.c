@@ -0,0 +1,331 @@
+/*******************************************************************************
+ * Copyright (C) 2017 Maxim Integrated Products, Inc., All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL MAXIM INTEGRATED BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Except as contained in this notice, the name of Maxim Integrated
+ * Products, Inc. shall not be used except as stated in the Maxim Integrated
+ * Products, Inc. Branding Policy.
+ *
+ * The mere transfer of this software does not imply any licenses
+ * of trade secrets, proprietary technology, copyrights, patents,
+ * trademarks, maskwork rights, or any other form of intellectual
+ * property whatsoever. Maxim Integrated Products, Inc. retains all
+ * ownership rights.
+ *
+ ******************************************************************************/
+
+
+#include "global.h"
+#include "sweep.h"
+#include "board.h"
+#include "config.h"
+#include "uui.h"
+
+// On-device sweeps.  A sweep steps a setting across a range of points and collects count
+// results at each one while the flow loop runs in max mode.  Settings are changed by
+// sweep_apply() between measurements.  One measurement is already in flight when a point
+// completes, so the first result of each point is discarded.
+//
+// A parameter sweep drives any shell setter and reports the tof_diff mean, standard deviation,
+// timeouts and measurement rate of each point as it completes.
+//
+// A bandpass sweep (MAX35104) steps F0, and optionally LOWQ, and scores each point by the mean
+// over its results of the hit period spread ((max-min)/mean of the per-wave period between
+// successive hits) plus the distance of T2/ideal from 1, summed over both directions.  A clean,
+// well centered filter gives evenly spaced zero crossings and a T2 that matches the ideal half
+// period.  Timeouts score TIMEOUT_SCORE.  The best point is applied and saved at the end.
+
+#define TIMEOUT_SCORE	4.0f
+#define LOWQ_COUNT		4
+
+static sweep_status_t	s_status;
+static uint8_t			s_count;
+static uint8_t			s_samples;		// results taken at this point, including timeouts
+static bool				s_pending;		// a new setting is waiting for sweep_apply()
+static bool				s_aborted;		// the pending setting is the abort restore
+static bool				s_settle;
+static uint32_t			s_point_time;
+
+// streaming statistics for the current point
+static sweep_stats_t	s_stats;
+static float_t			s_m2;
+
+// parameter sweep
+static sweep_set_t		s_p_set;
+static float_t			s_start;
+static float_t			s_step;
+
+// bandpass sweep
+static float_t			s_score;
+#ifdef MAX35104
+static uint8_t			s_f0_step;
+static uint16_t			s_f0;
+static uint16_t			s_lowq_value;
+#endif
+
+static void point_begin( void )
+{
+	s_samples = 0;
+	s_score = 0;
+	s_m2 = 0;
+	memset( &s_stats, 0, sizeof(s_stats) );
+	s_stats.value = s_start + s_step * (float_t)s_status.point;
+	s_pending = true;
+	s_settle = true;
+}
+
+static void point_end( void )
+{
+	float_t elapsed;
+	board_elapsed_time( s_point_time, &elapsed );
+	if( s_status.kind == sweep_kind_param )
+	{
+		if( s_stats.count > 1 )
+			s_stats.std = sqrtf( s_m2 / (float_t)(s_stats.count - 1) );
+		s_stats.rate = elapsed > 0 ? (float_t)s_samples / elapsed : 0;
+		uui_report_sweep( &s_stats );
+	}
+#ifdef MAX35104
+	else
+	{
+		float_t score = s_score / (float_t)s_samples;
+		if( score < s_status.best_score )
+		{
+			s_status.best_score = score;
+			s_status.best_f0 = s_f0;
+			s_status.best_lowq = s_lowq_value;
+		}
+		s_f0 += s_f0_step;
+		if( s_f0 > MAX3510X_REG_AFE2_F0_MAX )
+		{
+			s_f0 = 0;
+			s_lowq_value++;
+		}
+	}
+#endif
+	s_status.point++;
+	if( s_status.point >= s_status.points )
+	{
+		s_status.state = sweep_state_complete;
+		s_pending = true;
+		return;
+	}
+	point_begin();
+}
+
+static bool accept( void )
+{
+	// true if a result belongs to the current point
+	if( s_status.state != sweep_state_running || s_pending )
+		return false;
+	if( s_settle )
+	{
+		s_settle = false;
+		return false;
+	}
+	return true;
+}
+
+static void point_next( void )
+{
+	if( ++s_samples >= s_count )
+		point_end();
+}
+
+static void begin( sweep_kind_t kind, uint16_t points, uint8_t count )
+{
+	s_status.kind = kind;
+	s_status.points = points;
+	s_status.point = 0;
+	s_status.state = sweep_state_running;
+	s_aborted = false;
+	s_count = count;
+	point_begin();
+}
+
+bool sweep_start_param( sweep_set_t p_set, float_t start, float_t stop, float_t step, uint8_t count )
+{
+	float_t points = (stop - start) / step;
+	if( !p_set || !count || step == 0 || points < 0 || points > 65534.0f || sweep_active() )
+		return false;
+	s_p_set = p_set;
+	s_start = start;
+	s_step = step;
+	begin( sweep_kind_param, (uint16_t)(points + 1e-3f) + 1, count );
+	return true;
+}
+
+#ifdef MAX35104
+
+static void write_setting( uint16_t f0, uint16_t lowq )
+{
+	MAX3510X_WRITE_BITFIELD( NULL, AFE2, F0, f0 );
+	MAX3510X_WRITE_BITFIELD( NULL, AFE2, LOWQ, lowq );
+	max3510x_bandpass_calibrate( NULL );
+	board_wait_ms( 3 );	// wait for bandpass calibrate to complete.
+}
+
+static float_t direction_score( const fixed_measurement_t *p_fixed, const max3510x_measurement_t *p_raw, const uint8_t *p_hitwaves, uint8_t hitcount )
+{
+	fixed_t min = 0, max = 0, sum = 0;
+	uint8_t i;
+	float_t score = (float_t)MAX3510X_ENDIAN( p_raw->t2_ideal ) * (1.0f/128.0f) - 1.0f;
+	if( score < 0 )
+		score = -score;
+	for( i = 1; i < hitcount; i++ )
+	{
+		int16_t waves = (int16_t)p_hitwaves[i] - (int16_t)p_hitwaves[i-1];
+		fixed_t period;
+		if( waves <= 0 )
+			return score;
+		period = (p_fixed->hit[i] - p_fixed->hit[i-1]) / waves;
+		if( i == 1 || period < min )
+			min = period;
+		if( i == 1 || period > max )
+			max = period;
+		sum += period;
+	}
+	if( hitcount > 1 && sum > 0 )
+		score += (float_t)(max - min) * (float_t)(hitcount - 1) / (float_t)sum;
+	return score;
+}
+
+bool sweep_start_bandpass( uint8_t f0_step, uint8_t count, bool lowq )
+{
+	uint16_t current_lowq;
+	uint16_t points;
+	if( !f0_step || !count || sweep_active() )
+		return false;
+	current_lowq = MAX3510X_READ_BITFIELD( NULL, AFE2, LOWQ );
+	s_f0_step = f0_step;
+	points = MAX3510X_REG_AFE2_F0_MAX / f0_step + 1;
+	if( lowq )
+	{
+		points *= LOWQ_COUNT;
+		s_lowq_value = 0;
+	}
+	else
+	{
+		s_lowq_value = current_lowq;
+	}
+	s_f0 = 0;
+	s_start = 0;
+	s_step = 0;
+	s_status.best_score = 1e30f;
+	s_status.best_f0 = MAX3510X_READ_BITFIELD( NULL, AFE2, F0 );
+	s_status.best_lowq = current_lowq;
+	begin( sweep_kind_bandpass, points, count );
+	return true;
+}
+
+#endif
+
+void sweep_abort( void )
+{
+	// a bandpass sweep puts back the best setting found so far, but doesn't save it.
+	// a parameter sweep leaves the parameter at the current point.  A measurement may be in
+	// flight, so the restore is left to the next sweep_apply().
+	if( s_status.state == sweep_state_running )
+	{
+		s_status.state = sweep_state_idle;
+		s_aborted = s_status.kind == sweep_kind_bandpass;
+		s_pending = s_aborted;
+	}
+}
+
+bool sweep_active( void )
+{
+	return s_status.state == sweep_state_running || s_pending;
+}
+
+void sweep_apply( void )
+{
+	if( !s_pending )
+		return;
+	s_pending = false;
+	if( s_status.kind == sweep_kind_param )
+	{
+		if( s_status.state == sweep_state_running && !s_p_set( s_stats.value ) )
+		{
+			// the setter rejected the value.  stop here rather than measure a stale setting.
+			s_status.state = sweep_state_idle;
+			return;
+		}
+	}
+#ifdef MAX35104
+	else if( s_aborted )
+	{
+		s_aborted = false;
+		write_setting( s_status.best_f0, s_status.best_lowq );
+	}
+	else if( s_status.state == sweep_state_complete )
+	{
+		max3510x_registers_t *p_config = config_get_max3510x_regs(0);
+		write_setting( s_status.best_f0, s_status.best_lowq );
+		if( p_config )
+		{
+			max3510x_read_config( NULL, p_config );
+			config_save();
+		}
+	}
+	else
+	{
+		write_setting( s_f0, s_lowq_value );
+	}
+#endif
+	s_point_time = board_timestamp();
+}
+
+void sweep_sample( const fixed_tof_t *p_tof, const max3510x_tof_results_t *p_results, const uint8_t *p_hitwaves, uint8_t hitcount )
+{
+	if( !accept() )
+		return;
+	if( s_status.kind == sweep_kind_param )
+	{
+		// Welford's running mean and variance
+		float_t x = fixed_to_float( p_tof->tof_diff );
+		float_t delta = x - s_stats.mean;
+		s_stats.count++;
+		s_stats.mean += delta / (float_t)s_stats.count;
+		s_m2 += delta * (x - s_stats.mean);
+	}
+#ifdef MAX35104
+	else
+	{
+		s_score += direction_score( &p_tof->up, &p_results->up, p_hitwaves, hitcount ) +
+				   direction_score( &p_tof->down, &p_results->down, p_hitwaves, hitcount );
+	}
+#endif
+	point_next();
+}
+
+void sweep_timeout( void )
+{
+	if( !accept() )
+		return;
+	s_stats.timeouts++;
+	s_score += TIMEOUT_SCORE;
+	point_next();
+}
+
+const sweep_status_t * sweep_status( void )
+{
+	return &s_status;
+}
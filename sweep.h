@@ -0,0 +1,92 @@
+/*******************************************************************************
+ * Copyright (C) 2017 Maxim Integrated Products, Inc., All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL MAXIM INTEGRATED BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Except as contained in this notice, the name of Maxim Integrated
+ * Products, Inc. shall not be used except as stated in the Maxim Integrated
+ * Products, Inc. Branding Policy.
+ *
+ * The mere transfer of this software does not imply any licenses
+ * of trade secrets, proprietary technology, copyrights, patents,
+ * trademarks, maskwork rights, or any other form of intellectual
+ * property whatsoever. Maxim Integrated Products, Inc. retains all
+ * ownership rights.
+ *
+ ******************************************************************************/
+
+
+#ifndef __SWEEP_H__
+#define __SWEEP_H__
+
+#include "fixed.h"
+
+typedef enum _sweep_state_t
+{
+	sweep_state_idle,
+	sweep_state_running,
+	sweep_state_complete
+}
+sweep_state_t;
+
+typedef enum _sweep_kind_t
+{
+	sweep_kind_param,
+	sweep_kind_bandpass
+}
+sweep_kind_t;
+
+typedef struct _sweep_status_t
+{
+	sweep_state_t	state;
+	sweep_kind_t	kind;
+	uint16_t		point;		// current point
+	uint16_t		points;		// total points
+	uint16_t		best_f0;
+	uint16_t		best_lowq;
+	float_t			best_score;	// lower is better
+}
+sweep_status_t;
+
+typedef struct _sweep_stats_t
+{
+	float_t		value;		// parameter value for this point
+	uint16_t	count;		// valid results
+	uint16_t	timeouts;
+	float_t		mean;		// tof_diff (s)
+	float_t		std;
+	float_t		rate;		// measurements per second
+}
+sweep_stats_t;
+
+// parameter setter used by sweep_start_param().  returns false if the value was rejected.
+typedef bool (*sweep_set_t)( float_t value );
+
+bool sweep_start_param( sweep_set_t p_set, float_t start, float_t stop, float_t step, uint8_t count );
+#ifdef MAX35104
+bool sweep_start_bandpass( uint8_t f0_step, uint8_t count, bool lowq );
+#endif
+void sweep_abort( void );
+bool sweep_active( void );
+void sweep_apply( void );
+void sweep_sample( const fixed_tof_t *p_tof, const max3510x_tof_results_t *p_results, const uint8_t *p_hitwaves, uint8_t hitcount );
+void sweep_timeout( void );
+const sweep_status_t * sweep_status( void );
+
+#endif
@@ -0,0 +1,97 @@
+/*******************************************************************************
+ * Copyright (C) 2017 Maxim Integrated Products, Inc., All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL MAXIM INTEGRATED BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Except as contained in this notice, the name of Maxim Integrated
+ * Products, Inc. shall not be used except as stated in the Maxim Integrated
+ * Products, Inc. Branding Policy.
+ *
+ * The mere transfer of this software does not imply any licenses
+ * of trade secrets, proprietary technology, copyrights, patents,
+ * trademarks, maskwork rights, or any other form of intellectual
+ * property whatsoever. Maxim Integrated Products, Inc. retains all
+ * ownership rights.
+ *
+ ******************************************************************************/
+
+#include "global.h"
+#include "temperature.h"
+#include "temperature_table.h"
+
+// Resistance to temperature conversion.  The tables hold sensor resistance at evenly
+// spaced temperatures starting at -40C and are searched and linearly interpolated, so there
+// is no log() or sqrt() in the sample path.  They're generated into temperature_table.h by
+// tools/temperature_table.py from the equations below ('make tables' in gcc/).
+//
+// PT1000:  Callendar-Van Dusen, IEC 60751 coefficients, 5C steps (< 0.002C interpolation error)
+//     R(T) = R0 * ( 1 + A*T + B*T^2 + C*(T-100)*T^3 ), C = 0 for T >= 0
+//     R0 = 1000, A = 3.9083e-3, B = -5.775e-7, C = -4.183e-12
+//
+// NTC 10k:  Steinhart-Hart, 1C steps (< 0.01C interpolation error)
+//     1/T = a + b*ln(R) + c*ln(R)^3
+//     a = 1.009249522e-3, b = 2.378405444e-4, c = 2.019202697e-7
+
+typedef struct _lut_t
+{
+	const float_t *	p_r;
+	uint8_t			count;
+	float_t			t0;		// temperature of the first entry (C)
+	float_t			step;	// temperature step between entries (C)
+}
+lut_t;
+
+static const lut_t s_lut[] =
+{
+	{ s_pt1000, ARRAY_COUNT(s_pt1000), -40.0f, 5.0f },	// temperature_sensor_pt1000
+	{ s_ntc10k, ARRAY_COUNT(s_ntc10k), -40.0f, 1.0f }	// temperature_sensor_ntc10k
+};
+
+static temperature_sensor_t s_sensor;
+
+float_t temperature_convert( float_t resistance )
+{
+	// returns kelvin.  Values outside of the table are extrapolated from the end segments.
+	const lut_t *p_lut = &s_lut[s_sensor];
+	const float_t *p_r = p_lut->p_r;
+	uint8_t lo = 0, hi = p_lut->count - 1, mid;
+	bool ascending = p_r[0] < p_r[hi];
+
+	while( hi - lo > 1 )
+	{
+		mid = (lo + hi) >> 1;
+		if( (resistance >= p_r[mid]) == ascending )
+			lo = mid;
+		else
+			hi = mid;
+	}
+	float_t frac = (resistance - p_r[lo]) / (p_r[hi] - p_r[lo]);
+	return p_lut->t0 + ((float_t)lo + frac) * p_lut->step + 273.15f;
+}
+
+void temperature_set_sensor( temperature_sensor_t sensor )
+{
+	if( sensor < ARRAY_COUNT(s_lut) )
+		s_sensor = sensor;
+}
+
+temperature_sensor_t temperature_get_sensor( void )
+{
+	return s_sensor;
+}
@@ -0,0 +1,74 @@
+/*******************************************************************************
+ * Copyright (C) 2017 Maxim Integrated Products, Inc., All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL MAXIM INTEGRATED BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Except as contained in this notice, the name of Maxim Integrated
+ * Products, Inc. shall not be used except as stated in the Maxim Integrated
+ * Products, Inc. Branding Policy.
+ *
+ * The mere transfer of this software does not imply any licenses
+ * of trade secrets, proprietary technology, copyrights, patents,
+ * trademarks, maskwork rights, or any other form of intellectual
+ * property whatsoever. Maxim Integrated Products, Inc. retains all
+ * ownership rights.
+ *
+ ******************************************************************************/
+
+// Generated by tools/temperature_table.py.  Do not edit.
+
+#ifndef __TEMPERATURE_TABLE_H__
+#define __TEMPERATURE_TABLE_H__
+
+static const float_t s_pt1000[34] =
+{
+	842.70652f, 862.47785f, 882.21657f, 901.92339f, 921.59898f, 941.24394f,
+	960.85879f, 980.44401f, 1000.0f, 1019.5271f, 1039.0252f, 1058.4946f,
+	1077.935f, 1097.3466f, 1116.7292f, 1136.0831f, 1155.408f, 1174.7041f,
+	1193.9713f, 1213.2096f, 1232.419f, 1251.5996f, 1270.7513f, 1289.8741f,
+	1308.968f, 1328.0331f, 1347.0693f, 1366.0766f, 1385.055f, 1404.0046f,
+	1422.9253f, 1441.8171f, 1460.68f, 1479.5141f
+};
+
+static const float_t s_ntc10k[166] =
+{
+	205891.56f, 194712.0f, 184201.33f, 174316.07f, 165015.78f, 156262.83f, 148022.18f, 140261.23f,
+	132949.6f, 126058.98f, 119562.98f, 113437.0f, 107658.08f, 102204.82f, 97057.206f, 92196.578f,
+	87605.492f, 83267.651f, 79167.82f, 75291.754f, 71626.124f, 68158.463f, 64877.096f, 61771.097f,
+	58830.226f, 56044.894f, 53406.109f, 50905.445f, 48534.995f, 46287.345f, 44155.536f, 42133.034f,
+	40213.705f, 38391.788f, 36661.869f, 35018.859f, 33457.974f, 31974.717f, 30564.855f, 29224.405f,
+	27949.621f, 26736.973f, 25583.137f, 24484.984f, 23439.563f, 22444.093f, 21495.953f, 20592.67f,
+	19731.912f, 18911.478f, 18129.291f, 17383.39f, 16671.923f, 15993.141f, 15345.391f, 14727.112f,
+	14136.825f, 13573.136f, 13034.724f, 12520.34f, 12028.801f, 11558.989f, 11109.844f, 10680.363f,
+	10269.597f, 9876.6445f, 9500.6532f, 9140.8144f, 8796.3615f, 8466.5675f, 8150.743f, 7848.2337f,
+	7558.4187f, 7280.709f, 7014.5449f, 6759.3952f, 6514.7554f, 6280.1461f, 6055.1117f, 5839.2193f,
+	5632.0574f, 5433.2345f, 5242.3785f, 5059.1353f, 4883.168f, 4714.1562f, 4551.7945f, 4395.7925f,
+	4245.8736f, 4101.7743f, 3963.2435f, 3830.0421f, 3701.9422f, 3578.7265f, 3460.1878f, 3346.1287f,
+	3236.3608f, 3130.7043f, 3028.9878f, 2931.0476f, 2836.7276f, 2745.8787f, 2658.3584f, 2574.0308f,
+	2492.7659f, 2414.4399f, 2338.9339f, 2266.1348f, 2195.9341f, 2128.2283f, 2062.9185f, 1999.9097f,
+	1939.1116f, 1880.4372f, 1823.8038f, 1769.1318f, 1716.3453f, 1665.3716f, 1616.1409f, 1568.5866f,
+	1522.6446f, 1478.2538f, 1435.3555f, 1393.8934f, 1353.8136f, 1315.0645f, 1277.5965f, 1241.362f,
+	1206.3156f, 1172.4134f, 1139.6136f, 1107.8758f, 1077.1615f, 1047.4336f, 1018.6563f, 990.79571f,
+	963.81881f, 937.69411f, 912.39133f, 887.88137f, 864.13625f, 841.1291f, 818.8341f, 797.2264f,
+	776.28214f, 755.97834f, 736.29293f, 717.20467f, 698.69313f, 680.73863f, 663.32227f, 646.42584f,
+	630.0318f, 614.12329f, 598.68405f, 583.69846f, 569.15143f, 555.02846f, 541.31556f, 527.99928f,
+	515.06662f, 502.50507f, 490.30259f, 478.44755f, 466.92874f, 455.73536f
+};
+
+#endif
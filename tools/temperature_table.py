@@ -0,0 +1,126 @@
+#!/usr/bin/env python3
+################################################################################
+# Copyright (C) 2017 Maxim Integrated Products, Inc., All Rights Reserved.
+#
+# Permission is hereby granted, free of charge, to any person obtaining a
+# copy of this software and associated documentation files (the "Software"),
+# to deal in the Software without restriction, including without limitation
+# the rights to use, copy, modify, merge, publish, distribute, sublicense,
+# and/or sell copies of the Software, and to permit persons to whom the
+# Software is furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included
+# in all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+# OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+# MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+# IN NO EVENT SHALL MAXIM INTEGRATED BE LIABLE FOR ANY CLAIM, DAMAGES
+# OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+# ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+# OTHER DEALINGS IN THE SOFTWARE.
+#
+# Except as contained in this notice, the name of Maxim Integrated
+# Products, Inc. shall not be used except as stated in the Maxim Integrated
+# Products, Inc. Branding Policy.
+#
+# The mere transfer of this software does not imply any licenses
+# of trade secrets, proprietary technology, copyrights, patents,
+# trademarks, maskwork rights, or any other form of intellectual
+# property whatsoever. Maxim Integrated Products, Inc. retains all
+# ownership rights.
+#
+###############################################################################
+
+# Generates temperature_table.h, the resistance tables temperature.c interpolates.
+#
+#   python3 tools/temperature_table.py [output]
+#
+# The output defaults to temperature_table.h in the project root.  Entries are written
+# with eight significant digits, the precision of a float.
+
+import math
+import os
+import sys
+
+T0 = -40.0	# C, first entry of both tables
+T1 = 125.0	# C, last entry
+
+# PT1000, Callendar-Van Dusen with the IEC 60751 coefficients
+PT_R0 = 1000.0
+PT_A = 3.9083e-3
+PT_B = -5.775e-7
+PT_C = -4.183e-12
+PT_STEP = 5.0
+
+# 10k NTC, Steinhart-Hart
+NTC_A = 1.009249522e-3
+NTC_B = 2.378405444e-4
+NTC_C = 2.019202697e-7
+NTC_STEP = 1.0
+
+
+def pt1000(t):
+	c = PT_C if t < 0 else 0.0
+	return PT_R0 * (1.0 + PT_A * t + PT_B * t * t + c * (t - 100.0) * t ** 3)
+
+
+def cbrt(v):
+	return math.copysign(abs(v) ** (1.0 / 3.0), v)
+
+
+def ntc10k(t):
+	# solves 1/T = a + b*ln(R) + c*ln(R)^3 for ln(R)
+	x = (NTC_A - 1.0 / (t + 273.15)) / NTC_C
+	y = math.sqrt((NTC_B / (3.0 * NTC_C)) ** 3 + x * x / 4.0)
+	return math.exp(cbrt(y - x / 2.0) - cbrt(y + x / 2.0))
+
+
+def literal(v):
+	s = '%.8g' % v
+	if '.' not in s and 'e' not in s:
+		s += '.0'
+	return s + 'f'
+
+
+def table(name, fn, step, per_line):
+	count = int(round((T1 - T0) / step)) + 1
+	values = [literal(fn(T0 + i * step)) for i in range(count)]
+	lines = ['static const float_t %s[%d] =' % (name, count), '{']
+	for i in range(0, count, per_line):
+		row = ', '.join(values[i:i + per_line])
+		lines.append('\t' + row + (',' if i + per_line < count else ''))
+	lines.append('};')
+	return lines
+
+
+def license():
+	# the header block at the top of this file, as a C comment
+	block = []
+	with open(__file__) as f:
+		for line in f:
+			if line.startswith('#!'):
+				continue
+			if not line.startswith('#'):
+				break
+			block.append(' *' + line.rstrip('\n')[1:])
+	block[0] = '/' + '*' * 79
+	block[-1] = ' ' + '*' * 78 + '/'
+	return block
+
+
+def main():
+	root = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..')
+	path = sys.argv[1] if len(sys.argv) > 1 else os.path.join(root, 'temperature_table.h')
+	lines = license() + ['', '// Generated by tools/temperature_table.py.  Do not edit.', '',
+		'#ifndef __TEMPERATURE_TABLE_H__', '#define __TEMPERATURE_TABLE_H__', '']
+	lines += table('s_pt1000', pt1000, PT_STEP, 6)
+	lines.append('')
+	lines += table('s_ntc10k', ntc10k, NTC_STEP, 8)
+	lines += ['', '#endif', '']
+	with open(path, 'w', newline='\r\n') as f:
+		f.write('\n'.join(lines))
+
+
+if __name__ == '__main__':
+	main()
@@ -0,0 +1,87 @@
+/*******************************************************************************
+ * Copyright (C) 2017 Maxim Integrated Products, Inc., All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL MAXIM INTEGRATED BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Except as contained in this notice, the name of Maxim Integrated
+ * Products, Inc. shall not be used except as stated in the Maxim Integrated
+ * Products, Inc. Branding Policy.
+ *
+ * The mere transfer of this software does not imply any licenses
+ * of trade secrets, proprietary technology, copyrights, patents,
+ * trademarks, maskwork rights, or any other form of intellectual
+ * property whatsoever. Maxim Integrated Products, Inc. retains all
+ * ownership rights.
+ *
+ ******************************************************************************/
+
+#include "global.h"
+#include "totalizer.h"
+
+// Volume is accumulated in 64-bit nanoliter registers so that long running totals do not
+// lose resolution the way a float_t accumulator would.  The sub-nanoliter part of each
+// increment is carried into the next sample so rounding does not bias the totals.
+
+#define NL_PER_M3		1e12f
+#define LITERS_PER_NL	1e-6
+
+static int64_t s_forward;
+static int64_t s_reverse;
+static float_t s_residual;
+
+void totalizer_sample( float_t flow, float_t time )
+{
+	// flow in m^3/s, time in seconds.  a non-finite sample is dropped:  converting it would be
+	// undefined and it would poison the residual for good.
+	float_t nl;
+	int64_t n;
+	if( !isfinite( flow ) || !isfinite( time ) )
+		return;
+	nl = flow * time * NL_PER_M3 + s_residual;
+	if( !isfinite( nl ) || nl >= 9.2e18f || nl <= -9.2e18f )
+		return;
+	n = (int64_t)nl;
+	s_residual = nl - (float_t)n;
+	if( n >= 0 )
+		s_forward += n;
+	else
+		s_reverse -= n;
+}
+
+void totalizer_reset( void )
+{
+	s_forward = 0;
+	s_reverse = 0;
+	s_residual = 0;
+}
+
+double totalizer_forward( void )
+{
+	return (double)s_forward * LITERS_PER_NL;
+}
+
+double totalizer_reverse( void )
+{
+	return (double)s_reverse * LITERS_PER_NL;
+}
+
+double totalizer_net( void )
+{
+	return (double)(s_forward - s_reverse) * LITERS_PER_NL;
+}
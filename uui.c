@@ -36,6 +36,17 @@
 #include "uui.h"
 #include "config.h"
 #include "flow.h"
+#include "flowbody.h"
+#include "totalizer.h"
+#include "temperature.h"
+#include "calibration.h"
+#include "autotune.h"
+#include "sweep.h"
+#include "fusion.h"
+#include "zero.h"
+#include "recovery.h"
+#include "filter.h"
+#include "hampel.h"
 
 #include <tmr.h>
 #include <ctype.h>
@@ -54,8 +65,9 @@ static uint8_t s_command_read_ndx;
 
 static bool 		s_first;
 static float_t 		s_accumulation_time;
-static float_t		s_volume_last;
-static float_t		s_volume_first;
+static double		s_volume_last;
+static double		s_volume_first;
+static bool			s_display;
 static bool			s_output;
 static bool 		s_results_report;
 static uint32_t 	s_last_report_time;
@@ -482,15 +494,18 @@ static void _4m_bp_get( max3510x_t *p_max3510x )
 	board_printf("%s (%d)\r\n", r ? "CMOS clock input" : "oscillator", r);
 }
 
+static bool f0_write( max3510x_t *p_max3510x, float_t value )
+{
+	int16_t r = (int16_t)roundf( value );
+	if( r < 0 || r > MAX3510X_REG_AFE2_F0_MAX )
+		return false;
+	MAX3510X_WRITE_BITFIELD( p_max3510x, AFE2, F0, r );
+	return true;
+}
+
 static bool f0_set( max3510x_t *p_max3510x, const char *p_arg  )
 {
-	uint16_t r = atoi(p_arg);
-	if( r <= MAX3510X_REG_AFE2_F0_MAX )
-	{
-		MAX3510X_WRITE_BITFIELD( p_max3510x, AFE2, F0, r );
-		return true;
-	}
-	return false;
+	return f0_write( p_max3510x, (float_t)atoi(p_arg) );
 }
 
 static void f0_get( max3510x_t *p_max3510x )
@@ -499,9 +514,8 @@ static void f0_get( max3510x_t *p_max3510x )
 	board_printf("%d\r\n", r );
 }
 
-static bool pga_set( max3510x_t *p_max3510x, const char *p_arg )
+static bool pga_write( max3510x_t *p_max3510x, float_t gain_db )
 {
-	float_t gain_db = strtof(p_arg,NULL);
 	const float_t min_gain_db = MAX3510X_REG_AFE2_PGA((float_t)MAX3510X_REG_AFE2_PGA_DB_MIN);
 	const float_t max_gain_db = MAX3510X_REG_AFE2_PGA((float_t)MAX3510X_REG_AFE2_PGA_DB_MAX);
 	if( gain_db < min_gain_db || gain_db > max_gain_db )
@@ -510,8 +524,16 @@ static bool pga_set( max3510x_t *p_max3510x, const char *p_arg )
 	}
 	uint16_t r = (uint16_t)MAX3510X_REG_AFE2_PGA_DB(gain_db);
 	MAX3510X_WRITE_BITFIELD( p_max3510x, AFE2, PGA, r );
-	gain_db = MAX3510X_REG_AFE2_PGA(r);
-	board_printf("pga = %.2fdB (%d)\r\n", gain_db, r );
+	return true;
+}
+
+static bool pga_set( max3510x_t *p_max3510x, const char *p_arg )
+{
+	uint16_t r;
+	if( !pga_write( p_max3510x, strtof(p_arg,NULL) ) )
+		return false;
+	r = MAX3510X_READ_BITFIELD( p_max3510x, AFE2, PGA );
+	board_printf("pga = %.2fdB (%d)\r\n", MAX3510X_REG_AFE2_PGA((float_t)r), r );
 	return true;
 }
 
@@ -565,10 +587,10 @@ static void bp_bp_get( max3510x_t *p_max3510x )
 
 #endif //  MAX35104
 
-static bool pl_set( max3510x_t *p_max3510x, const char *p_arg )
+static bool pl_write( max3510x_t *p_max3510x, float_t value )
 {
-	uint16_t r = atoi(p_arg);
-	if( r > MAX3510X_REG_TOF1_PL_MAX  )
+	int16_t r = (int16_t)roundf( value );
+	if( r < 0 || r > MAX3510X_REG_TOF1_PL_MAX  )
 	{
 		return false;
 	}
@@ -576,16 +598,22 @@ static bool pl_set( max3510x_t *p_max3510x, const char *p_arg )
 	return true;
 }
 
+static bool pl_set( max3510x_t *p_max3510x, const char *p_arg )
+{
+	return pl_write( p_max3510x, (float_t)atoi(p_arg) );
+}
+
 static void pl_get( max3510x_t *p_max3510x )
 {
 	uint16_t r = MAX3510X_READ_BITFIELD(p_max3510x,TOF1,PL);
 	board_printf("%d pulses\r\n", r);
 }
 
-static bool dpl_set( max3510x_t *p_max3510x, const char *p_arg )
+static bool dpl_write( max3510x_t *p_max3510x, float_t value )
 {
+	// rounds to the nearest supported launch frequency
 	uint16_t r;
-	int32_t freq = atoi(p_arg);
+	int32_t freq = (int32_t)roundf( value );
 	
 	uint8_t i;
 	int32_t f;
@@ -611,7 +639,16 @@ static bool dpl_set( max3510x_t *p_max3510x, const char *p_arg )
 	}
 	r = MAX3510X_REG_TOF1_DPL_HZ(MAX3510X_CLOCK_FREQ/1000,nearest);
 	MAX3510X_WRITE_BITFIELD( p_max3510x, TOF1, DPL, r );
-	board_printf("dpl = %dkHz (%d)\r\n", nearest, r );
+	return true;
+}
+
+static bool dpl_set( max3510x_t *p_max3510x, const char *p_arg )
+{
+	uint16_t r;
+	if( !dpl_write( p_max3510x, (float_t)atoi(p_arg) ) )
+		return false;
+	r = MAX3510X_READ_BITFIELD(p_max3510x,TOF1,DPL);
+	board_printf("dpl = %dkHz (%d)\r\n", MAX3510X_REG_TOF1_DPL((MAX3510X_CLOCK_FREQ/1000),r), r );
 	return true;
 }
 
@@ -662,15 +699,20 @@ static void stop_get( max3510x_t *p_max3510x )
 	board_printf("hitcount = %d (%d)\r\n", hitcount, r );
 }
 
-static bool t2wv_set( max3510x_t *p_max3510x, const char *p_arg )
+static bool t2wv_write( max3510x_t *p_max3510x, float_t value )
 {
-	uint16_t r = atoi(p_arg);
+	int16_t r = (int16_t)roundf( value );
 	if( r > MAX3510X_REG_TOF2_TW2V_MAX || r < MAX3510X_REG_TOF2_TW2V_MIN )
 		return false;
 	MAX3510X_WRITE_BITFIELD(p_max3510x,TOF2,TW2V,r);
 	return true;
 }
 
+static bool t2wv_set( max3510x_t *p_max3510x, const char *p_arg )
+{
+	return t2wv_write( p_max3510x, (float_t)atoi(p_arg) );
+}
+
 static void t2wv_get( max3510x_t *p_max3510x )
 {
 	uint16_t r = MAX3510X_READ_BITFIELD(p_max3510x,TOF2,TW2V);
@@ -737,6 +779,15 @@ static void timout_get( max3510x_t *p_max3510x )
 	board_printf("%sms (%d)\r\n", p, r );
 }
 
+static bool offset_value( float_t value, int8_t *p_r )
+{
+	int16_t r = (int16_t)roundf( value );
+	if( r < INT8_MIN || r > INT8_MAX )
+		return false;
+	*p_r = (int8_t)r;
+	return true;
+}
+
 #if !defined(MAX35102)
 
 static bool hitwv_set( max3510x_t *p_max3510x, const char *p_arg )
@@ -798,13 +849,20 @@ static void hitwv_get( max3510x_t *p_max3510x )
 	board_printf("%d, %d, %d, %d, %d, %d\r\n", hw[0], hw[1], hw[2], hw[3], hw[4], hw[5] );
 }
 
-static bool c_offsetupr_set( max3510x_t *p_max3510x, const char *p_arg )
+static bool c_offsetupr_write( max3510x_t *p_max3510x, float_t value )
 {
-	int8_t r = atoi(p_arg);
+	int8_t r;
+	if( !offset_value( value, &r ) )
+		return false;
 	MAX3510X_WRITE_BITFIELD(p_max3510x,TOF6,C_OFFSETUPR,r);
 	return true;
 }
 
+static bool c_offsetupr_set( max3510x_t *p_max3510x, const char *p_arg )
+{
+	return c_offsetupr_write( p_max3510x, (float_t)atoi(p_arg) );
+}
+
 
 static void c_offsetupr_get( max3510x_t *p_max3510x )
 {
@@ -814,13 +872,20 @@ static void c_offsetupr_get( max3510x_t *p_max3510x )
 
 #endif // #if !defined(MAX35102)
 
-static bool c_offsetup_set( max3510x_t *p_max3510x, const char *p_arg )
+static bool c_offsetup_write( max3510x_t *p_max3510x, float_t value )
 {
-	int8_t r = atoi(p_arg);
+	int8_t r;
+	if( !offset_value( value, &r ) )
+		return false;
 	MAX3510X_WRITE_BITFIELD(p_max3510x,TOF6,C_OFFSETUP,r);
 	return true;
 }
 
+static bool c_offsetup_set( max3510x_t *p_max3510x, const char *p_arg )
+{
+	return c_offsetup_write( p_max3510x, (float_t)atoi(p_arg) );
+}
+
 static void c_offsetup_get( max3510x_t *p_max3510x )
 {
 	int8_t r = MAX3510X_READ_BITFIELD(p_max3510x,TOF6,C_OFFSETUP);
@@ -829,13 +894,20 @@ static void c_offsetup_get( max3510x_t *p_max3510x )
 
 #if !defined(MAX35102)
 
-static bool c_offsetdnr_set( max3510x_t *p_max3510x, const char *p_arg )
+static bool c_offsetdnr_write( max3510x_t *p_max3510x, float_t value )
 {
-	int8_t r = atoi(p_arg);
+	int8_t r;
+	if( !offset_value( value, &r ) )
+		return false;
 	MAX3510X_WRITE_BITFIELD(p_max3510x,TOF7,C_OFFSETDNR,r);
 	return true;
 }
 
+static bool c_offsetdnr_set( max3510x_t *p_max3510x, const char *p_arg )
+{
+	return c_offsetdnr_write( p_max3510x, (float_t)atoi(p_arg) );
+}
+
 static void c_offsetdnr_get( max3510x_t *p_max3510x )
 {
 	int8_t r = MAX3510X_READ_BITFIELD(p_max3510x,TOF7,C_OFFSETDNR);
@@ -844,13 +916,20 @@ static void c_offsetdnr_get( max3510x_t *p_max3510x )
 
 #endif
 
-static bool c_offsetdn_set( max3510x_t *p_max3510x, const char *p_arg )
+static bool c_offsetdn_write( max3510x_t *p_max3510x, float_t value )
 {
-	int8_t r = atoi(p_arg);
+	int8_t r;
+	if( !offset_value( value, &r ) )
+		return false;
 	MAX3510X_WRITE_BITFIELD(p_max3510x,TOF7,C_OFFSETDN,r);
 	return true;
 }
 
+static bool c_offsetdn_set( max3510x_t *p_max3510x, const char *p_arg )
+{
+	return c_offsetdn_write( p_max3510x, (float_t)atoi(p_arg) );
+}
+
 static void c_offsetdn_get( max3510x_t *p_max3510x )
 {
 	int8_t r = MAX3510X_READ_BITFIELD(p_max3510x,TOF7,C_OFFSETDN);
@@ -1054,18 +1133,24 @@ static void portcyc_get( max3510x_t *p_max3510x )
 }
 
 
-static bool dly_set( max3510x_t *p_max3510x, const char *p_arg )
+static bool dly_write( max3510x_t *p_max3510x, float_t dly )
 {
-	float_t dly = strtof(p_arg,NULL);
 	int16_t r = MAX3510X_REG_TOF_MEASUREMENT_DELAY_DLY_US(dly);
 
 	if( r < MAX3510X_REG_TOF_MEASUREMENT_DELAY_DLY_MIN )
 		return false;
 
 	MAX3510X_WRITE_BITFIELD(p_max3510x,TOF_MEASUREMENT_DELAY,DLY,r);
+	return true;
+}
 
+static bool dly_set( max3510x_t *p_max3510x, const char *p_arg )
+{
+	int16_t r;
+	if( !dly_write( p_max3510x, strtof(p_arg,NULL) ) )
+		return false;
+	r = MAX3510X_READ_BITFIELD(p_max3510x,TOF_MEASUREMENT_DELAY,DLY);
 	board_printf("%.2fus (%d)\r\n", (float_t)MAX3510X_REG_TOF_MEASUREMENT_DELAY_DLY(r), r );
-
 	return true;
 }
 
@@ -1341,6 +1426,94 @@ static bool tof_temp_set( max3510x_t *p_max3510x, const char *p_arg )
 	return true;
 }
 
+static const enum_t s_seq_cmd_enum[] =
+{
+	{ "diff", flow_seq_cmd_tof_diff },
+	{ "up", flow_seq_cmd_tof_up },
+	{ "down", flow_seq_cmd_tof_down },
+	{ "temp", flow_seq_cmd_temp },
+	{ "cal", flow_seq_cmd_cal }
+};
+
+static const enum_t s_seq_priority_enum[] =
+{
+	{ "high", flow_seq_priority_high },
+	{ "low", flow_seq_priority_low }
+};
+
+static void seq_get( max3510x_t *p_max3510x )
+{
+	flow_seq_slot_t slot[FLOW_SEQ_MAX_SLOTS];
+	uint8_t count = flow_get_sequence( slot );
+	uint8_t i;
+	for( i = 0; i < count; i++ )
+	{
+		board_printf( "%s%s:%d:%s", i ? "," : "",
+			get_enum_tag( s_seq_cmd_enum, ARRAY_COUNT(s_seq_cmd_enum), slot[i].cmd ),
+			slot[i].repeat,
+			get_enum_tag( s_seq_priority_enum, ARRAY_COUNT(s_seq_priority_enum), slot[i].priority ) );
+	}
+	board_printf( "\r\n" );
+}
+
+static bool seq_set( max3510x_t *p_max3510x, const char *p_arg )
+{
+	// comma separated list of cmd[:repeat[:priority]], or "tof_temp" to revert to the tof_temp pattern
+	flow_seq_slot_t slot[FLOW_SEQ_MAX_SLOTS];
+	uint8_t count = 0;
+	char tag[8];
+	uint8_t len;
+	uint16_t value;
+
+	if( !strcmp( p_arg, "tof_temp" ) )
+	{
+		flow_set_sequence( NULL, 0 );
+		seq_get( p_max3510x );
+		return true;
+	}
+	while( *p_arg )
+	{
+		if( count >= FLOW_SEQ_MAX_SLOTS )
+			return false;
+		for( len = 0; isalpha(*p_arg) && len < sizeof(tag)-1; len++ )
+			tag[len] = *p_arg++;
+		tag[len] = 0;
+		if( !get_enum_value( tag, s_seq_cmd_enum, ARRAY_COUNT(s_seq_cmd_enum), &value ) )
+			return false;
+		slot[count].cmd = value;
+		slot[count].repeat = 1;
+		slot[count].priority = flow_seq_priority_high;
+		if( *p_arg == ':' )
+		{
+			char *p_end;
+			uint32_t repeat = strtoul( p_arg+1, &p_end, 10 );
+			if( p_end == p_arg+1 || !repeat || repeat > 255 )
+				return false;
+			slot[count].repeat = repeat;
+			p_arg = p_end;
+		}
+		if( *p_arg == ':' )
+		{
+			p_arg++;
+			for( len = 0; isalpha(*p_arg) && len < sizeof(tag)-1; len++ )
+				tag[len] = *p_arg++;
+			tag[len] = 0;
+			if( !get_enum_value( tag, s_seq_priority_enum, ARRAY_COUNT(s_seq_priority_enum), &value ) )
+				return false;
+			slot[count].priority = value;
+		}
+		count++;
+		if( *p_arg == ',' )
+			p_arg++;
+		else if( *p_arg )
+			return false;
+	}
+	if( !count || !flow_set_sequence( slot, count ) )
+		return false;
+	seq_get( p_max3510x );
+	return true;
+}
+
 static void sampling_get( max3510x_t *p_max3510x )
 {
 	float_t freq = flow_get_sampling_frequency();
@@ -1360,18 +1533,630 @@ static bool sampling_set( max3510x_t *p_max3510x, const char *p_arg )
 	return true;
 }
 
-static bool save_config( max3510x_t *p_max3510x, const char *p_arg )
+static const enum_t s_sos_enum[] =
+{
+	{ "direct", flow_sos_method_direct },
+	{ "air", flow_sos_method_ideal_air }
+};
+
+static void sos_get( max3510x_t *p_max3510x )
+{
+	flow_sos_method_t method = flow_get_sos_method();
+	const char *p = get_enum_tag( s_sos_enum, ARRAY_COUNT(s_sos_enum), method );
+	board_printf("%s\r\n", p );
+}
+
+static bool sos_set( max3510x_t *p_max3510x, const char *p_arg )
+{
+	uint16_t result;
+	if( get_enum_value(p_arg, s_sos_enum, ARRAY_COUNT(s_sos_enum), &result ) )
+	{
+		flow_set_sos_method( (flow_sos_method_t)result );
+		return true;
+	}
+	return false;
+}
+
+static bool path_arg( const char *p_arg, uint8_t *p_first, uint8_t *p_last, float_t *p_value )
+{
+	// "value" applies to every path, "path,value" to one
+	char *p_end;
+	float_t value = strtof( p_arg, &p_end );
+	if( p_end == p_arg )
+		return false;
+	*p_first = 0;
+	*p_last = FLOW_INSTANCE_COUNT - 1;
+	if( *p_end == ',' )
+	{
+		if( value < 0.0f || value >= (float_t)FLOW_INSTANCE_COUNT || value != (float_t)(uint8_t)value )
+			return false;
+		*p_first = *p_last = (uint8_t)value;
+		p_arg = p_end + 1;
+		value = strtof( p_arg, &p_end );
+		if( p_end == p_arg )
+			return false;
+	}
+	*p_value = value;
+	return true;
+}
+
+static void path_len_get( max3510x_t *p_max3510x )
+{
+	uint8_t i;
+	for( i = 0; i < FLOW_INSTANCE_COUNT; i++ )
+		board_printf( i ? ",%.2fmm" : "%.2fmm", flowbody_get_path_length(i) * 1000.0f );
+	board_printf("\r\n");
+}
+
+static bool path_len_set( max3510x_t *p_max3510x, const char *p_arg )
+{
+	uint8_t i, first, last;
+	float_t mm;
+	if( !path_arg( p_arg, &first, &last, &mm ) || mm <= 0.0f )
+		return false;
+	for( i = first; i <= last; i++ )
+		flowbody_set_path_length( i, mm / 1000.0f );
+	return true;
+}
+
+static void path_angle_get( max3510x_t *p_max3510x )
+{
+	uint8_t i;
+	for( i = 0; i < FLOW_INSTANCE_COUNT; i++ )
+		board_printf( i ? ",%.2f" : "%.2f", flowbody_get_path_angle(i) );
+	board_printf(" degrees\r\n");
+}
+
+static bool path_angle_set( max3510x_t *p_max3510x, const char *p_arg )
+{
+	uint8_t i, first, last;
+	float_t degrees;
+	if( !path_arg( p_arg, &first, &last, &degrees ) || degrees < 0.0f || degrees >= 90.0f )
+		return false;
+	for( i = first; i <= last; i++ )
+		flowbody_set_path_angle( i, degrees );
+	return true;
+}
+
+static void area_get( max3510x_t *p_max3510x )
+{
+	board_printf("%.2fmm^2\r\n", flowbody_get_area() * 1e6f );
+}
+
+static bool area_set( max3510x_t *p_max3510x, const char *p_arg )
+{
+	float_t mm2 = strtof(p_arg,NULL);
+	if( mm2 <= 0.0f )
+		return false;
+	flowbody_set_area( mm2 / 1e6f );
+	return true;
+}
+
+static void flow_get( max3510x_t *p_max3510x )
+{
+	const flowbody_result_t *p_result = flow_get_result();
+	board_printf("sos = %.2fm/s, velocity = %.4fm/s, flow = %.4fLPM, filtered = %.4fLPM\r\n", p_result->sos, p_result->velocity, p_result->flow * 1000.0f * 60.0f, flow_get_filtered_flow() * 1000.0f * 60.0f );
+	uint8_t i;
+	for( i = 0; i < FLOW_INSTANCE_COUNT; i++ )
+	{
+#if FLOW_INSTANCE_COUNT > 1
+		p_result = flow_get_path_result(i);
+		board_printf("path %d:  sos = %.2fm/s, velocity = %.4fm/s, ", i, p_result->sos, p_result->velocity );
+#endif
+		board_printf("filtered tof_diff = %.1fps\r\n", fixed_to_float( flow_get_filtered_tof_diff(i) ) * 1e12f );
+	}
+}
+
+static const enum_t s_sensor_enum[] =
+{
+	{ "pt1000", temperature_sensor_pt1000 },
+	{ "ntc", temperature_sensor_ntc10k }
+};
+
+static void sensor_get( max3510x_t *p_max3510x )
+{
+	temperature_sensor_t sensor = temperature_get_sensor();
+	const char *p = get_enum_tag( s_sensor_enum, ARRAY_COUNT(s_sensor_enum), sensor );
+	board_printf("%s\r\n", p );
+}
+
+static bool sensor_set( max3510x_t *p_max3510x, const char *p_arg )
+{
+	uint16_t result;
+	if( get_enum_value(p_arg, s_sensor_enum, ARRAY_COUNT(s_sensor_enum), &result ) )
+	{
+		temperature_set_sensor( (temperature_sensor_t)result );
+		return true;
+	}
+	return false;
+}
+
+static void temperature_get( max3510x_t *p_max3510x )
+{
+	board_printf("%.3fC\r\n", flow_get_temperature() - 273.15f );
+}
+
+static void cal_interval_get( max3510x_t *p_max3510x )
+{
+	board_printf("%.1fs\r\n", calibration_get_interval() );
+}
+
+static bool cal_interval_set( max3510x_t *p_max3510x, const char *p_arg )
+{
+	float_t seconds = strtof( p_arg, NULL );
+	if( seconds < 0 )
+		return false;
+	calibration_set_interval( seconds );
+	cal_interval_get( p_max3510x );
+	return true;
+}
+
+static void cal_drift_get( max3510x_t *p_max3510x )
+{
+	board_printf("%.2fC\r\n", calibration_get_drift() );
+}
+
+static bool cal_drift_set( max3510x_t *p_max3510x, const char *p_arg )
 {
-	max3510x_registers_t *p_config = config_get_max3510x_regs();
-	if( p_config )
+	float_t drift = strtof( p_arg, NULL );
+	if( drift < 0 )
+		return false;
+	calibration_set_drift( drift );
+	cal_drift_get( p_max3510x );
+	return true;
+}
+
+static void cal_factor_get( max3510x_t *p_max3510x )
+{
+	if( calibration_valid() )
+		board_printf("4MX = %d, factor = %e\r\n", calibration_get_frequency(), calibration_get_factor() );
+	else
+		board_printf("not calibrated\r\n");
+}
+
+#ifdef MAX35104
+
+static const enum_t s_agc_enum[] =
+{
+	{ "off", autotune_agc_mode_off },
+	{ "on", autotune_agc_mode_on },
+	{ "interleave", autotune_agc_mode_interleave }
+};
+
+static void agc_get( max3510x_t *p_max3510x )
+{
+	autotune_agc_mode_t mode = autotune_get_agc_mode();
+	const char *p = get_enum_tag( s_agc_enum, ARRAY_COUNT(s_agc_enum), mode );
+	board_printf("%s\r\n", p );
+}
+
+static bool agc_set( max3510x_t *p_max3510x, const char *p_arg )
+{
+	uint16_t result;
+	if( get_enum_value(p_arg, s_agc_enum, ARRAY_COUNT(s_agc_enum), &result ) )
 	{
-		max3510x_read_config( NULL, p_config );
-		config_save();
+		autotune_set_agc_mode( (autotune_agc_mode_t)result );
 		return true;
 	}
 	return false;
 }
 
+static void agc_gains_get( max3510x_t *p_max3510x )
+{
+	uint16_t a, b;
+	autotune_get_interleave_gains( &a, &b );
+	board_printf("%.2fdB(%d), %.2fdB(%d)\r\n", MAX3510X_REG_AFE2_PGA((float_t)a), a, MAX3510X_REG_AFE2_PGA((float_t)b), b );
+}
+
+static bool agc_gains_set( max3510x_t *p_max3510x, const char *p_arg )
+{
+	// two gains in dB separated by a comma.  x records use the first, y records the second.
+	const float_t min_gain_db = MAX3510X_REG_AFE2_PGA((float_t)MAX3510X_REG_AFE2_PGA_DB_MIN);
+	const float_t max_gain_db = MAX3510X_REG_AFE2_PGA((float_t)MAX3510X_REG_AFE2_PGA_DB_MAX);
+	char *p_end;
+	float_t gain_a = strtof( p_arg, &p_end );
+	if( *p_end != ',' )
+		return false;
+	float_t gain_b = strtof( p_end+1, NULL );
+	if( gain_a < min_gain_db || gain_a > max_gain_db || gain_b < min_gain_db || gain_b > max_gain_db )
+		return false;
+	autotune_set_interleave_gains( (uint16_t)MAX3510X_REG_AFE2_PGA_DB(gain_a), (uint16_t)MAX3510X_REG_AFE2_PGA_DB(gain_b) );
+	agc_gains_get( p_max3510x );
+	return true;
+}
+
+#endif
+
+static void autothresh_get( max3510x_t *p_max3510x )
+{
+	board_printf("%d\r\n", autotune_threshold_enabled() ? 1 : 0 );
+}
+
+static bool autothresh_set( max3510x_t *p_max3510x, const char *p_arg )
+{
+	autotune_threshold_enable( atoi(p_arg) ? true : false );
+	autothresh_get( p_max3510x );
+	return true;
+}
+
+static void autowindow_get( max3510x_t *p_max3510x )
+{
+	board_printf("%d\r\n", autotune_window_enabled() ? 1 : 0 );
+}
+
+static bool autowindow_set( max3510x_t *p_max3510x, const char *p_arg )
+{
+	autotune_window_enable( atoi(p_arg) ? true : false );
+	autowindow_get( p_max3510x );
+	return true;
+}
+
+static void slips_get( max3510x_t *p_max3510x )
+{
+	board_printf("up = %d, down = %d\r\n", flow_get_slips(0), flow_get_slips(1) );
+}
+
+static bool slips_set( max3510x_t *p_max3510x, const char *p_arg )
+{
+	if( atoi(p_arg) )
+		return false;
+	flow_clear_slips();
+	slips_get( p_max3510x );
+	return true;
+}
+
+static void path_weights_get( max3510x_t *p_max3510x )
+{
+	float_t weight[FLOW_INSTANCE_COUNT];
+	uint8_t i;
+	fusion_get_weights( weight );
+	for( i = 0; i < FLOW_INSTANCE_COUNT; i++ )
+		board_printf( i ? ",%.4f" : "%.4f", weight[i] );
+	board_printf("\r\n");
+}
+
+static bool path_weights_set( max3510x_t *p_max3510x, const char *p_arg )
+{
+	// one weight per path separated by commas
+	float_t weight[FLOW_INSTANCE_COUNT];
+	char *p_end;
+	uint8_t count = 0;
+	while( count < FLOW_INSTANCE_COUNT )
+	{
+		weight[count++] = strtof( p_arg, &p_end );
+		if( p_end == p_arg || *p_end != ',' )
+			break;
+		p_arg = p_end + 1;
+	}
+	if( !fusion_set_weights( weight, count ) )
+		return false;
+	path_weights_get( p_max3510x );
+	return true;
+}
+
+static void path_mask_get( max3510x_t *p_max3510x )
+{
+	board_printf("mask = 0x%02X, healthy = 0x%02X\r\n", fusion_get_mask(), fusion_get_health() );
+}
+
+static bool path_mask_set( max3510x_t *p_max3510x, const char *p_arg )
+{
+	char *p_end;
+	uint32_t mask = strtoul( p_arg, &p_end, 16 );
+	if( p_end == p_arg || mask >= (1UL<<FLOW_INSTANCE_COUNT) )
+		return false;
+	fusion_set_mask( (uint8_t)mask );
+	path_mask_get( p_max3510x );
+	return true;
+}
+
+static void zero_get( max3510x_t *p_max3510x )
+{
+	uint8_t i;
+	board_printf("learn = %d, offset = ", zero_enabled() ? 1 : 0 );
+	for( i = 0; i < FLOW_INSTANCE_COUNT; i++ )
+		board_printf( i ? ",%.1fps" : "%.1fps", fixed_to_float( zero_get_offset(i) ) * 1e12f );
+	board_printf("\r\n");
+}
+
+static bool zero_set( max3510x_t *p_max3510x, const char *p_arg )
+{
+	if( !strcmp( p_arg, "reset" ) )
+		zero_reset();
+	else if( !strcmp( p_arg, "now" ) )
+		zero_capture();
+	else
+		zero_enable( atoi(p_arg) ? true : false );
+	zero_get( p_max3510x );
+	return true;
+}
+
+static void zero_limits_get( max3510x_t *p_max3510x )
+{
+	float_t band, noise, seed;
+	zero_get_limits( &band, &noise, &seed );
+	board_printf("band = %.1fps, noise = %.1fps, seed = %.1fps\r\n", band * 1e12f, noise * 1e12f, seed * 1e12f );
+}
+
+static bool zero_limits_set( max3510x_t *p_max3510x, const char *p_arg )
+{
+	// no-flow band, noise limit and seed limit in ps separated by commas
+	char *p_end;
+	float_t band = strtof( p_arg, &p_end );
+	if( *p_end != ',' )
+		return false;
+	float_t noise = strtof( p_end+1, &p_end );
+	if( *p_end != ',' )
+		return false;
+	float_t seed = strtof( p_end+1, NULL );
+	if( band <= 0 || noise <= 0 || seed < 0 )
+		return false;
+	zero_set_limits( band * 1e-12f, noise * 1e-12f, seed * 1e-12f );
+	zero_limits_get( p_max3510x );
+	return true;
+}
+
+#ifdef UUI_SELF_TEST
+
+static bool zero_test_cmd( max3510x_t *p_max3510x, const char *p_arg )
+{
+	// feeds path 0 a constant offset well outside the no-flow band, then a small drift that
+	// should be tracked, then a flow step that should not be learned.
+
+	static const struct
+	{
+		float_t	tof_diff;	// ps
+		uint8_t	windows;
+		float_t	expected;	// ps
+	}
+	phase[] = { { 5000.0f, 1, 5000.0f }, { 5500.0f, 48, 5500.0f }, { 20000.0f, 8, 5500.0f } };
+	fixed_t offset[FLOW_INSTANCE_COUNT];
+	float_t band, noise, seed, learned, corrected = 0;
+	bool enabled = zero_enabled();
+	bool passed = true;
+	uint8_t i;
+	uint16_t j;
+
+	for( i = 0; i < FLOW_INSTANCE_COUNT; i++ )
+		offset[i] = zero_get_offset( i );
+	zero_get_limits( &band, &noise, &seed );
+
+	zero_enable( false );
+	zero_set_limits( 1e-9f, 50e-12f, 10e-9f );
+	zero_set_offset( 0, 0 );
+	zero_enable( true );
+	for( i = 0; i < ARRAY_COUNT(phase) && passed; i++ )
+	{
+		for( j = 0; j < phase[i].windows * 32; j++ )
+		{
+			// +/-10ps of noise keeps every window quiet
+			float_t ps = phase[i].tof_diff + ( (j & 1) ? 10.0f : -10.0f );
+			corrected = fixed_to_float( zero_correct( 0, (fixed_t)( ps * 1e-12f / FIXED_TO_SECONDS ) ) ) * 1e12f;
+		}
+		// rounding stalls the gain step within 4 LSB (~15ps) of the mean
+		learned = fixed_to_float( zero_get_offset( 0 ) ) * 1e12f;
+		if( fabsf( learned - phase[i].expected ) > 25.0f )
+		{
+			board_printf("test failed:  %.0fps learned %.1fps, expected %.0fps\r\n", phase[i].tof_diff, learned, phase[i].expected );
+			passed = false;
+		}
+	}
+	if( passed && fabsf( corrected - 14500.0f ) > 40.0f )
+	{
+		board_printf("test failed:  corrected %.1fps\r\n", corrected );
+		passed = false;
+	}
+
+	zero_enable( false );
+	zero_set_limits( band, noise, seed );
+	for( i = 0; i < FLOW_INSTANCE_COUNT; i++ )
+		zero_set_offset( i, offset[i] );
+	zero_enable( enabled );
+	if( passed )
+		board_printf("test passed\r\n");
+	return true;
+}
+
+#endif
+
+static void recovery_get( max3510x_t *p_max3510x )
+{
+	board_printf("budget = %d, options = 0x%02X\r\n", recovery_get_budget(), recovery_get_options() );
+}
+
+static bool recovery_set( max3510x_t *p_max3510x, const char *p_arg )
+{
+	// retry budget, optionally followed by a comma and the options bitmask in hex
+	char *p_end;
+	long budget = strtol( p_arg, &p_end, 10 );
+	if( p_end == p_arg || budget < 0 || budget > 254 )
+		return false;
+	recovery_set_budget( (uint8_t)budget );
+	if( *p_end == ',' )
+		recovery_set_options( (uint8_t)strtoul( p_end+1, NULL, 16 ) );
+	recovery_get( p_max3510x );
+	return true;
+}
+
+static void timeouts_get( max3510x_t *p_max3510x )
+{
+	uint8_t i;
+	const recovery_stats_t *p_stats;
+	for( i = 0; i < FLOW_INSTANCE_COUNT; i++ )
+	{
+		p_stats = recovery_get_stats(i);
+#if FLOW_INSTANCE_COUNT > 1
+		board_printf("path %d:  ", i );
+#endif
+		board_printf("up = %d, down = %d, diff = %d, temp = %d, cal = %d, retries = %d, backoffs = %d, restores = %d, recoveries = %d\r\n",
+			p_stats->timeouts_up, p_stats->timeouts_down, p_stats->timeouts_diff, p_stats->timeouts_temp, p_stats->timeouts_cal,
+			p_stats->retries, p_stats->backoffs, p_stats->restores, p_stats->recoveries );
+	}
+}
+
+static bool timeouts_set( max3510x_t *p_max3510x, const char *p_arg )
+{
+	if( atoi(p_arg) )
+		return false;
+	recovery_clear_stats();
+	timeouts_get( p_max3510x );
+	return true;
+}
+
+static void totalizer_get( max3510x_t *p_max3510x )
+{
+	board_printf("forward = %.6fL, reverse = %.6fL, net = %.6fL\r\n", totalizer_forward(), totalizer_reverse(), totalizer_net() );
+}
+
+static bool totalizer_set( max3510x_t *p_max3510x, const char *p_arg )
+{
+	if( atoi(p_arg) )
+		return false;
+	totalizer_reset();
+	s_first = true;
+	return true;
+}
+
+static bool display_set( max3510x_t *p_max3510x, const char *p_arg )
+{
+	uint16_t r;
+	if( !binary( p_arg, &r ) )
+		return false;
+	s_display = r;
+	s_first = true;
+	return true;
+}
+
+static void display_get( max3510x_t *p_max3510x )
+{
+	board_printf("%s (%d)\r\n", s_display ? "on" : "off", s_display );
+}
+
+static void queue_get( max3510x_t *p_max3510x )
+{
+	board_printf("high water = %d, overflow = %d\r\n", flow_get_queue_high_water(), flow_get_queue_overflow() );
+}
+
+static bool queue_set( max3510x_t *p_max3510x, const char *p_arg )
+{
+	if( atoi(p_arg) )
+		return false;
+	flow_clear_queue_stats();
+	return true;
+}
+
+static void hits_get( max3510x_t *p_max3510x )
+{
+	const fixed_t *p_up, *p_down;
+	uint8_t i, j, hitcount;
+	for( i = 0; i < FLOW_INSTANCE_COUNT; i++ )
+	{
+		hitcount = flow_get_filtered_hits( i, &p_up, &p_down );
+#if FLOW_INSTANCE_COUNT > 1
+		board_printf("path %d:  ", i );
+#endif
+		board_printf("up =");
+		for( j = 0; j < hitcount; j++ )
+			board_printf(" %.6f", fixed_to_float( p_up[j] ) * 1e6f );
+		board_printf("us, down =");
+		for( j = 0; j < hitcount; j++ )
+			board_printf(" %.6f", fixed_to_float( p_down[j] ) * 1e6f );
+		board_printf("us\r\n");
+	}
+}
+
+static const enum_t s_filter_enum[] =
+{
+	{ "butterworth", filter_type_butterworth },
+	{ "bessel", filter_type_bessel }
+};
+
+static void filter_get( max3510x_t *p_max3510x )
+{
+	const char *p = get_enum_tag( s_filter_enum, ARRAY_COUNT(s_filter_enum), filter_get_type() );
+	board_printf("%s,%d,%.3fHz\r\n", p, filter_get_order(), filter_get_cutoff() );
+}
+
+static bool filter_set( max3510x_t *p_max3510x, const char *p_arg )
+{
+	// type,order,cutoff
+	char type[16];
+	const char *p_comma = strchr( p_arg, ',' );
+	char *p_end;
+	uint16_t result;
+	long order;
+	float_t cutoff;
+	if( !p_comma || p_comma - p_arg >= (long)sizeof(type) )
+		return false;
+	memcpy( type, p_arg, p_comma - p_arg );
+	type[p_comma - p_arg] = 0;
+	if( !get_enum_value( type, s_filter_enum, ARRAY_COUNT(s_filter_enum), &result ) )
+		return false;
+	order = strtol( p_comma+1, &p_end, 10 );
+	if( *p_end != ',' || order < 1 || order > FILTER_MAX_ORDER )
+		return false;
+	cutoff = strtof( p_end+1, NULL );
+	if( !filter_set_design( (filter_type_t)result, (uint8_t)order, cutoff ) )
+		return false;
+	filter_get( p_max3510x );
+	return true;
+}
+
+static void hampel_get( max3510x_t *p_max3510x )
+{
+	board_printf("window = %d, threshold = %.2f\r\n", hampel_get_window(), hampel_get_threshold() );
+}
+
+static bool hampel_set( max3510x_t *p_max3510x, const char *p_arg )
+{
+	// window,threshold
+	char *p_end;
+	long window = strtol( p_arg, &p_end, 10 );
+	if( p_end == p_arg || window < 0 || window > HAMPEL_MAX_WINDOW || *p_end != ',' )
+		return false;
+	if( !hampel_set_window( (uint8_t)window, strtof( p_end+1, NULL ) ) )
+		return false;
+	hampel_get( p_max3510x );
+	return true;
+}
+
+static void outliers_get( max3510x_t *p_max3510x )
+{
+	uint8_t i;
+	for( i = 0; i < FLOW_INSTANCE_COUNT; i++ )
+	{
+#if FLOW_INSTANCE_COUNT > 1
+		board_printf("path %d:  ", i );
+#endif
+		board_printf("rejected = %d\r\n", hampel_get_rejected(i) );
+	}
+}
+
+static bool outliers_set( max3510x_t *p_max3510x, const char *p_arg )
+{
+	if( atoi(p_arg) )
+		return false;
+	hampel_clear_rejected();
+	outliers_get( p_max3510x );
+	return true;
+}
+
+static bool save_config( max3510x_t *p_max3510x, const char *p_arg )
+{
+	uint8_t i;
+	max3510x_registers_t *p_config;
+	for( i = 0; i < FLOW_INSTANCE_COUNT; i++ )
+	{
+		p_config = config_get_max3510x_regs(i);
+		if( !p_config )
+			return false;
+		if( flow_path_present(i) )
+			max3510x_read_config( flow_get_device(i), p_config );
+	}
+	config_save();
+	return true;
+}
+
 
 static bool start_event_cmd( max3510x_t *p_max3510x, const char *p_arg )
 {
@@ -1501,8 +2286,162 @@ static bool results_report_cmd(  max3510x_t *p_max3510x, const char *p_arg )
 	return true;
 }
 
+static bool bench_cmd( max3510x_t *p_max3510x, const char *p_arg )
+{
+	// compares the per-sample cost of the float conversion path against the fixed point pipeline
+	// using a synthetic result block, then the per-sample and block filter paths in float and Q31.
+	// both filters are designed for the configured filter at the current sampling frequency.
+
+	uint32_t i, count = 1000, blocks;
+	float_t rate = flow_get_sampling_frequency();
+	uint8_t h;
+	uint32_t timestamp;
+	float_t float_time, fixed_time, sample_time, block_time;
+	filter_t filter;
+	float_t block[FILTER_BLOCK_SIZE];
+	filter_q31_t filter_q31;
+	q31_t tof_block[FILTER_BLOCK_SIZE], q31_block[FILTER_BLOCK_SIZE];
+	float_t error = 0;
+	max3510x_tof_results_t results;
+	fixed_tof_t tof;
+	volatile float_t float_sink;
+	volatile fixed_t fixed_sink;
+
+	if( *p_arg )
+	{
+		count = atoi(p_arg);
+		if( !count )
+			return false;
+	}
+	memset( &results, 0, sizeof(results) );
+	for(h=0;h<MAX3510X_MAX_HITCOUNT;h++)
+	{
+		results.up.hit[h].integer = MAX3510X_ENDIAN( 400 + h * 20 );
+		results.up.hit[h].fraction = MAX3510X_ENDIAN( 0x1234 );
+		results.down.hit[h].integer = MAX3510X_ENDIAN( 400 + h * 20 );
+		results.down.hit[h].fraction = MAX3510X_ENDIAN( 0x1200 );
+	}
+
+	timestamp = board_timestamp();
+	for(i=0;i<count;i++)
+	{
+		float_t up = 0, down = 0;
+		for(h=0;h<MAX_HITCOUNT;h++)
+		{
+			up += max3510x_fixed_to_float( &results.up.hit[h] );
+			down += max3510x_fixed_to_float( &results.down.hit[h] );
+		}
+		float_sink = (up - down) / (float_t)MAX_HITCOUNT;
+	}
+	board_elapsed_time( timestamp, &float_time );
+
+	timestamp = board_timestamp();
+	for(i=0;i<count;i++)
+	{
+		fixed_tof( &tof, &results, MAX_HITCOUNT );
+		fixed_sink = tof.tof_diff;
+	}
+	board_elapsed_time( timestamp, &fixed_time );
+
+	board_printf("float = %.3fus, fixed = %.3fus per sample\r\n", float_time * 1e6f / count, fixed_time * 1e6f / count );
+
+	// the same biquad cascade run one sample at a time and a block at a time
+	filter_init( &filter, rate );
+	for(i=0;i<FILTER_BLOCK_SIZE;i++)
+		block[i] = (float_t)i;
+	timestamp = board_timestamp();
+	for(i=0;i<count;i++)
+		float_sink = filter_sample( &filter, block[i % FILTER_BLOCK_SIZE] );
+	board_elapsed_time( timestamp, &sample_time );
+
+	timestamp = board_timestamp();
+	for(i=0;i<count;i+=FILTER_BLOCK_SIZE)
+		filter_block( &filter, block, block, FILTER_BLOCK_SIZE );
+	board_elapsed_time( timestamp, &block_time );
+	blocks = (count + FILTER_BLOCK_SIZE - 1) / FILTER_BLOCK_SIZE;
+
+	board_printf("filter:  sample = %.1f, block = %.1f cycles per sample\r\n",
+		sample_time * (float_t)SystemCoreClock / count,
+		block_time * (float_t)SystemCoreClock / ( blocks * FILTER_BLOCK_SIZE ) );
+
+	// the Q31 filter on a raw tof_diff, timed the same way and checked against the float filter
+	filter_q31_init( &filter_q31, rate );
+	for(i=0;i<FILTER_BLOCK_SIZE;i++)
+		tof_block[i] = (q31_t)( 20000 + 300 * (int32_t)((i*7) % 5) - 600 );
+	timestamp = board_timestamp();
+	for(i=0;i<count;i++)
+		fixed_sink = filter_q31_sample( &filter_q31, tof_block[i % FILTER_BLOCK_SIZE] );
+	board_elapsed_time( timestamp, &sample_time );
+
+	timestamp = board_timestamp();
+	for(i=0;i<count;i+=FILTER_BLOCK_SIZE)
+		filter_q31_block( &filter_q31, tof_block, q31_block, FILTER_BLOCK_SIZE );
+	board_elapsed_time( timestamp, &block_time );
+
+	filter_init( &filter, rate );
+	filter_q31_init( &filter_q31, rate );
+	for(i=0;i<count;i++)
+	{
+		q31_t x = tof_block[i % FILTER_BLOCK_SIZE];
+		float_t e = (float_t)filter_q31_sample( &filter_q31, x ) - filter_sample( &filter, (float_t)x );
+		if( e < 0 )
+			e = -e;
+		if( e > error )
+			error = e;
+	}
+	board_printf("q31 filter:  sample = %.1f, block = %.1f cycles per sample, max error = %.2fps\r\n",
+		sample_time * (float_t)SystemCoreClock / count,
+		block_time * (float_t)SystemCoreClock / ( blocks * FILTER_BLOCK_SIZE ),
+		fixed_to_float( 1 ) * error * 1e12f );
+	return true;
+}
+
+#ifdef UUI_SELF_TEST
+
+static bool filter_test_cmd( max3510x_t *p_max3510x, const char *p_arg )
+{
+	// DC gain of the configured filter at the current sampling frequency, float and Q31, for a
+	// 76ns tof_diff of either sign.  the run is long enough for the slowest design to settle.
+
+	static const q31_t input[] = { 20000, -20000 };
+	float_t rate = flow_get_sampling_frequency();
+	uint32_t i, n = (uint32_t)( 50.0f * rate / filter_get_cutoff() );
+	filter_t filter;
+	filter_q31_t filter_q31;
+	float_t y = 0;
+	q31_t y_q31 = 0;
+	bool passed = true;
+	uint8_t j;
+
+	if( n > 100000 )
+		n = 100000;
+	for( j = 0; j < ARRAY_COUNT(input); j++ )
+	{
+		q31_t x = input[j];
+		filter_init( &filter, rate );
+		filter_q31_init( &filter_q31, rate );
+		for( i = 0; i < n; i++ )
+		{
+			y = filter_sample( &filter, (float_t)x );
+			y_q31 = filter_q31_sample( &filter_q31, x );
+		}
+		if( fabsf( y / (float_t)x - 1.0f ) > 1e-3f || abs( y_q31 - x ) > 2 + abs( x ) / 1000 )
+		{
+			board_printf("test failed:  %.1fHz, in = %d, float = %.1f, q31 = %d\r\n", rate, x, y, y_q31 );
+			passed = false;
+		}
+	}
+	if( passed )
+		board_printf("test passed\r\n");
+	return true;
+}
+
+#endif
+
 static bool help_cmd( max3510x_t *p_max3510x, const char *p_arg );
 static bool dc_cmd( max3510x_t *p_max3510x, const char *p_arg );
+static bool sweep_set( max3510x_t *p_max3510x, const char *p_arg );
+static void sweep_get( max3510x_t *p_max3510x );
 
 static const cmd_t s_cmd[] =
 {
@@ -1583,10 +2522,49 @@ static const cmd_t s_cmd[] =
 
 	{ "spi_test", "perform's a write/read verification test on the max3510x", spi_test_cmd, NULL },
 	{ "tof_temp", "number of tof measurements for each temperature measurement", tof_temp_set, tof_temp_get },
+	{ "seq", "measurement sequence:  cmd[:repeat[:high|low]],...  cmd is diff, up, down, temp or cal", seq_set, seq_get },
 	{ "default", "restore configuration defaults", default_cmd, NULL },
 	{ "mode", "select sampling mode: event, host, max, idle", mode_set, mode_get },
 	{ "sampling", "host mode sampling frequency", sampling_set, sampling_get },
 	{ "report", "turn on sample reports until a key is pressed", results_report_cmd, NULL },
+	{ "sos", "speed of sound method:  direct or air", sos_set, sos_get },
+	{ "path_len", "acoustic path length (mm):  mm for every path, or path,mm", path_len_set, path_len_get },
+	{ "path_angle", "angle between the acoustic path and the pipe axis (degrees):  0 to 89, or path,degrees", path_angle_set, path_angle_get },
+	{ "area", "pipe cross section (mm^2)", area_set, area_get },
+	{ "flow", "last computed speed of sound, velocity and flow", NULL, flow_get },
+	{ "sensor", "temperature sensor type:  pt1000 or ntc", sensor_set, sensor_get },
+	{ "temperature", "last measured temperature", NULL, temperature_get },
+	{ "cal_interval", "maximum time between calibrations (s), 0 to disable", cal_interval_set, cal_interval_get },
+	{ "cal_drift", "temperature change that triggers a calibration (C), 0 to disable", cal_drift_set, cal_drift_get },
+	{ "cal_factor", "cached 4MHz calibration", NULL, cal_factor_get },
+	{ "sweep", "sweep a parameter:  <param> <start> <stop> <step> <n>, 0=abort", sweep_set, sweep_get },
+#ifdef MAX35104
+	{ "agc", "automatic pga gain control:  off, on or interleave", agc_set, agc_get },
+	{ "agc_gains", "interleave mode pga gains:  gain_a,gain_b (dB)", agc_gains_set, agc_gains_get },
+#endif
+	{ "autothresh", "track the T1 threshold (c_offsetup/c_offsetdn) from t1/t2:  1=on, 0=off", autothresh_set, autothresh_get },
+	{ "autowindow", "track dly and timout from the measured tof:  1=on, 0=off", autowindow_set, autowindow_get },
+	{ "slips", "cycle slips corrected in each direction:  0=clear", slips_set, slips_get },
+	{ "path_weights", "path integration weights:  w0,w1,...", path_weights_set, path_weights_get },
+	{ "path_mask", "paths included in the flow (hex bitmask)", path_mask_set, path_mask_get },
+	{ "zero", "zero flow offset learning:  1=on, 0=off, reset=clear the offsets, now=the pipe is still", zero_set, zero_get },
+	{ "zero_limits", "no-flow detection:  band,noise,seed (ps)", zero_limits_set, zero_limits_get },
+#ifdef UUI_SELF_TEST
+	{ "zero_test", "verifies zero flow offset learning on path 0", zero_test_cmd, NULL },
+#endif
+	{ "recovery", "timeout recovery:  retries[,options]  options 1=restore settings, 2=bandpass cal", recovery_set, recovery_get },
+	{ "timeouts", "timeout and recovery counters:  0=clear", timeouts_set, timeouts_get },
+	{ "totalizer", "forward, reverse and net volume:  0=reset", totalizer_set, totalizer_get },
+	{ "display", "periodic LPM/liters display:  1=on, 0=off", display_set, display_get },
+	{ "queue", "sample queue statistics:  0=clear", queue_set, queue_get },
+	{ "filter", "flow filter:  butterworth|bessel,order,cutoff (Hz)  order 1 to 4", filter_set, filter_get },
+	{ "hits", "filtered up and down hit times", NULL, hits_get },
+	{ "hampel", "tof_diff outlier rejection:  window,threshold  window 0=off or odd 3 to 31, threshold in MADs", hampel_set, hampel_get },
+	{ "outliers", "tof_diff samples rejected as outliers:  0=clear", outliers_set, outliers_get },
+	{ "bench", "time the float and fixed point tof pipelines:  optional iteration count", bench_cmd, NULL },
+#ifdef UUI_SELF_TEST
+	{ "filter_test", "checks the DC gain of the filter at the sampling frequency", filter_test_cmd, NULL },
+#endif
 	{ "help", "you're looking at it", help_cmd, NULL }
 };
 
@@ -1620,6 +2598,132 @@ static bool dc_cmd( max3510x_t *p_max3510x, const char *p_arg )
 	return true;
 }
 
+typedef struct _sweep_param_t
+{
+	const char *	p_name;
+	bool (*p_write)( max3510x_t *, float_t );
+}
+sweep_param_t;
+
+// parameters the sweep can step.  these write the register directly rather than going
+// through the shell setters, which echo and would break up the sweep's CSV rows.
+
+static const sweep_param_t s_sweep_param[] =
+{
+#if defined(MAX35104)
+	{ "f0", f0_write },
+	{ "pga", pga_write },
+#endif
+	{ "pl", pl_write },
+	{ "dpl", dpl_write },
+	{ "t2wv", t2wv_write },
+#if !defined(MAX35102)
+	{ "c_offsetupr", c_offsetupr_write },
+	{ "c_offsetdnr", c_offsetdnr_write },
+#endif
+	{ "c_offsetup", c_offsetup_write },
+	{ "c_offsetdn", c_offsetdn_write },
+	{ "dly", dly_write }
+};
+
+static uint8_t s_sweep_param_ndx;	// s_sweep_param entry being swept
+
+static bool sweep_param_set( float_t value )
+{
+	// sweeps act on the default device
+	return s_sweep_param[s_sweep_param_ndx].p_write( NULL, value );
+}
+
+static void sweep_get( max3510x_t *p_max3510x )
+{
+	const sweep_status_t *p_status = sweep_status();
+	if( p_status->state == sweep_state_running )
+		board_printf("point %d of %d", p_status->point + 1, p_status->points );
+	else if( p_status->state == sweep_state_complete )
+		board_printf("complete" );
+	else
+		board_printf("idle" );
+#ifdef MAX35104
+	if( p_status->kind == sweep_kind_bandpass )
+	{
+		board_printf(", best f0 = %d, lowq = %skHz/kHz, score = %.4f", p_status->best_f0,
+			get_enum_tag( s_lowq_enum, ARRAY_COUNT(s_lowq_enum), p_status->best_lowq ), p_status->best_score );
+	}
+#endif
+	board_printf("\r\n");
+}
+
+static bool sweep_set( max3510x_t *p_max3510x, const char *p_arg )
+{
+	// <param> <start> <stop> <step> <n> sweeps one of the s_sweep_param[] settings.
+	// bandpass[ f0_step[ n[ lowq]]] runs the f0 sweep on the MAX35104.  0 aborts.
+	char name[16];
+	char *p_end;
+	uint8_t len, i;
+	float_t start, stop, step;
+	uint32_t count;
+
+	if( !strcmp( p_arg, "0" ) )
+	{
+		flow_sweep_abort();
+		sweep_get( p_max3510x );
+		return true;
+	}
+	for( len = 0; *p_arg && !isspace(*p_arg) && len < sizeof(name)-1; len++ )
+		name[len] = *p_arg++;
+	name[len] = 0;
+	p_arg = skip_space( p_arg );
+#ifdef MAX35104
+	if( !strcmp( name, "bandpass" ) )
+	{
+		uint32_t f0_step = 4;
+		bool lowq = false;
+		count = 8;
+		if( *p_arg )
+		{
+			f0_step = strtoul( p_arg, &p_end, 10 );
+			p_arg = skip_space( p_end );
+		}
+		if( *p_arg )
+		{
+			count = strtoul( p_arg, &p_end, 10 );
+			p_arg = skip_space( p_end );
+		}
+		if( *p_arg )
+		{
+			if( strcmp( p_arg, "lowq" ) )
+				return false;
+			lowq = true;
+		}
+		if( !f0_step || f0_step > MAX3510X_REG_AFE2_F0_MAX || !count || count > 255 )
+			return false;
+		if( !flow_sweep_bandpass( f0_step, count, lowq ) )
+			return false;
+		sweep_get( p_max3510x );
+		return true;
+	}
+#endif
+	for( i = 0; i < ARRAY_COUNT(s_sweep_param); i++ )
+	{
+		if( !strcmp( name, s_sweep_param[i].p_name ) )
+			break;
+	}
+	if( i == ARRAY_COUNT(s_sweep_param) )
+		return false;
+	start = strtof( p_arg, &p_end );
+	stop = strtof( p_end, &p_end );
+	step = strtof( p_end, &p_end );
+	count = strtoul( p_end, &p_end, 10 );
+	if( *skip_space( p_end ) || !count || count > 255 )
+		return false;
+	s_sweep_param_ndx = i;
+	if( !flow_sweep_param( sweep_param_set, start, stop, step, count ) )
+		return false;
+	// param, n, tof_diff mean, tof_diff std, timeouts, measurements/s
+	board_printf( "%s,n,mean,std,timeouts,rate\r\n", s_sweep_param[i].p_name );
+	return true;
+}
+
 static bool help_cmd( max3510x_t *p_max3510x, const char *p_arg )
 {
 	uint8_t i;
@@ -1826,6 +2930,7 @@ static void command( void )
 void uui_init(void)
 {
 	s_output = true;
+	s_first = true;
 	board_printf("> ");
 }
 
@@ -1834,14 +2939,16 @@ void uui_event( uint32_t event )
 {
 	if( event & BOARD_EVENT_SYSTICK )
 	{
-		if( s_output && s_display_count && s_accumulation_time )
+		// the totalizer is sampled on the tick rather than per measurement
+		uui_update( totalizer_net() );
+		if( s_output && s_display && s_display_count && s_accumulation_time )
 		{
 			if( !--s_display_count )
 			{
 				s_display_count = DISPLAY_COUNT;
-				float_t volume_liters = (s_volume_last - s_volume_first) * 1000.0f * 60.0f; // cubic meters to liters
-				float_t volume_rate = volume_liters / s_accumulation_time; // lpm
-			//	board_printf( "\33[2K\r%.3f LPM, %.3fL\r\n> ", volume_rate, s_volume_last * 1000.0f * 60.0f );
+				float_t volume_liters = (float_t)(s_volume_last - s_volume_first);
+				float_t volume_rate = volume_liters * 60.0f / s_accumulation_time; // lpm
+				board_printf( "\33[2K\r%.3f LPM, %.3fL\r\n> ", volume_rate, s_volume_last );
 				s_first = true;
 			}
 		}
@@ -1866,15 +2973,11 @@ void uui_cal_complete( void )
 {
 	if( s_output )
 	{
-		max3510x_fixed_t fixed;
-		max3510x_read_fixed(NULL,MAX3510X_REG_CALIBRATIONINT,&fixed);
-		uint32_t _4mhz_xtal_freq = max3510x_input_frequency( &fixed );
-		float_t factor = max3510x_calibration_factor( _4mhz_xtal_freq );
-		uui_cmd_response( "4MX = %d, factor = %e", (uint32_t)_4mhz_xtal_freq, factor);
+		uui_cmd_response( "4MX = %d, factor = %e", calibration_get_frequency(), calibration_get_factor() );
 	}
 }
 
-void uui_update( float_t volume )
+void uui_update( double volume )
 {
 	static uint32_t timestamp;
 	if( s_first )
@@ -1893,10 +2996,11 @@ void uui_update( float_t volume )
 
 }
 
-void uui_report_results( float_t *p_up, float_t *p_down, float_t time, uint8_t hitcount, uint8_t ndx )
+void uui_report_results( const fixed_tof_t *p_tof, float_t time, uint8_t hitcount, uint8_t ndx )
 {
 	if( s_results_report )
 	{
+		// this is the output edge of the pipeline.  Hits are only converted to seconds when they are printed.
 		s_time += time;
 
 		// up hits [6], down hits [6], time
@@ -1911,28 +3015,29 @@ void uui_report_results( float_t *p_up, float_t *p_down, float_t time, uint8_t h
 		}
 		for(i=0;i<hitcount;i++)
 		{
-			board_printf( ",%e", p_up[i] );
+			board_printf( ",%e", fixed_to_float( p_tof->up.hit[i] ) );
 		}
 		for(i=0;i<hitcount;i++)
 		{
-			board_printf( ",%e", p_down[i] );
+			board_printf( ",%e", fixed_to_float( p_tof->down.hit[i] ) );
 		}
 		board_printf(",%e\r\n", s_time);
-#ifdef PGA_SWITCH		
-		if( pga_switch )
-			pga_17_98();
-		else
-			pga_13_99();
-		pga_switch = !pga_switch;
-#endif		
 	}
 }
 
+void uui_report_sweep( const sweep_stats_t *p_stats )
+{
+	// one row per sweep point
+	board_printf( "%g,%d,%e,%e,%d,%.1f\r\n", p_stats->value, p_stats->count + p_stats->timeouts,
+		p_stats->mean, p_stats->std, p_stats->timeouts, p_stats->rate );
+}
+
 void uui_report_temp( float_t temp_K )
 {
-	if( s_output )
+	if( s_results_report )
 	{
-		board_printf("\33[2K\r%.1fC\r\n> ", temp_K  - 273.15f );
+		// temperature record interleaved with the hit records
+		board_printf( "t,%e,%e\r\n", temp_K, s_time );
 	}
 }
 
@@ -2077,9 +3182,8 @@ void uui_report_tof_temp( uint16_t status )
 		{
 			max3510x_fixed_t fixed;
 			max3510x_read_fixed(NULL,MAX3510X_REG_CALIBRATIONINT,&fixed);
-			uint32_t _4mhz_xtal_freq = max3510x_input_frequency( &fixed );
-			float_t factor = max3510x_calibration_factor( _4mhz_xtal_freq );
-			board_printf( "4MX = %d, factor = %e", (uint32_t)_4mhz_xtal_freq, factor);
+			calibration_update( &fixed, flow_get_temperature() );
+			board_printf( "4MX = %d, factor = %e", calibration_get_frequency(), calibration_get_factor() );
 			break;
 		}
 	}
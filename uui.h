@@ -32,17 +32,20 @@
  ******************************************************************************/
 
 #include "max3510x.h"
+#include "fixed.h"
+#include "sweep.h"
 
 void uui_init(void);
 void uui_event( uint32_t event );
-void uui_update( float_t volume );
+void uui_update( double volume );
 
-void uui_report_results( float_t *p_up, float_t *p_down, float_t time, uint8_t hitcount, uint8_t ndx );
+void uui_report_results( const fixed_tof_t *p_tof, float_t time, uint8_t hitcount, uint8_t ndx );
 
 void uui_cmd_response( const char *, ... );
 void uui_cal_complete( void );
 
 void uui_report_temp( float_t temp_K );
+void uui_report_sweep( const sweep_stats_t *p_stats );
 void uui_report_tof_temp( uint16_t status );
 
 static void tof_temp_get( max3510x_t *p_max3510x );
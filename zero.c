@@ -0,0 +1,190 @@
+/*******************************************************************************
+ * Copyright (C) 2017 Maxim Integrated Products, Inc., All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL MAXIM INTEGRATED BE LIABLE FOR ANY CLAIM, DAMAGES
+ * OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Except as contained in this notice, the name of Maxim Integrated
+ * Products, Inc. shall not be used except as stated in the Maxim Integrated
+ * Products, Inc. Branding Policy.
+ *
+ * The mere transfer of this software does not imply any licenses
+ * of trade secrets, proprietary technology, copyrights, patents,
+ * trademarks, maskwork rights, or any other form of intellectual
+ * property whatsoever. Maxim Integrated Products, Inc. retains all
+ * ownership rights.
+ *
+ ******************************************************************************/
+
+
+#include "global.h"
+#include "zero.h"
+#include "flow.h"
+
+// Learns the tof_diff each path reads at zero flow (transducer and electronics asymmetry)
+// and removes it from the pipeline.
+//
+// Raw tof_diff is collected in windows of ZERO_WINDOW samples.  A window is quiet when its
+// standard deviation is below the noise limit -- real flow, even slow flow, adds turbulence
+// to the difference.  A path without an offset seeds it from the first quiet window whose
+// mean is within the seed limit of zero, the largest asymmetry the transducers are expected
+// to have, so steady flow at startup can't be taken for the zero.  zero_capture() is the
+// operator saying the pipe is still:  the next quiet window seeds the offset whatever its
+// size.  After that a window is taken as no-flow when it is quiet and its mean is within the
+// band of the learned offset, and the offset moves toward that mean by ZERO_GAIN, so a
+// single misjudged window can only pull it a fraction of the way.
+
+#define ZERO_WINDOW		32
+#define ZERO_GAIN		0.125f
+
+typedef struct _zero_path_t
+{
+	fixed_t		offset;
+	bool		learned;	// offset holds a measured or configured value
+	bool		capture;	// seed from the next quiet window, whatever its mean
+	uint8_t		count;
+	float_t		mean;		// window mean and sum of squared deviations (Welford)
+	float_t		m2;
+}
+zero_path_t;
+
+static zero_path_t	s_path[FLOW_INSTANCE_COUNT];
+static bool			s_enabled;
+static float_t		s_band = 1e-9f / FIXED_TO_SECONDS;		// 1ns
+static float_t		s_noise = 50e-12f / FIXED_TO_SECONDS;	// 50ps
+static float_t		s_seed = 10e-9f / FIXED_TO_SECONDS;		// 10ns
+
+static void learn( zero_path_t *p_path, fixed_t tof_diff )
+{
+	float_t x = (float_t)tof_diff;
+	float_t delta = x - p_path->mean;
+	float_t std;
+
+	p_path->count++;
+	p_path->mean += delta / (float_t)p_path->count;
+	p_path->m2 += delta * ( x - p_path->mean );
+	if( p_path->count < ZERO_WINDOW )
+		return;
+
+	std = sqrtf( p_path->m2 / (float_t)(ZERO_WINDOW - 1) );
+	if( std <= s_noise )
+	{
+		float_t offset = (float_t)p_path->offset;
+		float_t error = p_path->mean - offset;
+		if( p_path->capture || !p_path->learned )
+		{
+			// a mean too far from zero to seed from waits for the operator
+			if( p_path->capture || ( p_path->mean <= s_seed && p_path->mean >= -s_seed ) )
+			{
+				offset = p_path->mean;
+				p_path->learned = true;
+				p_path->capture = false;
+			}
+		}
+		else if( error <= s_band && error >= -s_band )
+			offset += ZERO_GAIN * error;
+		p_path->offset = (fixed_t)( offset < 0 ? offset - 0.5f : offset + 0.5f );
+	}
+	p_path->count = 0;
+	p_path->mean = 0;
+	p_path->m2 = 0;
+}
+
+fixed_t zero_correct( uint8_t path, fixed_t tof_diff )
+{
+	zero_path_t *p_path;
+	if( path >= FLOW_INSTANCE_COUNT )
+		return tof_diff;
+	p_path = &s_path[path];
+	if( s_enabled || p_path->capture )
+		learn( p_path, tof_diff );
+	return tof_diff - p_path->offset;
+}
+
+void zero_enable( bool enable )
+{
+	uint8_t i;
+	if( enable == s_enabled )
+		return;
+	for( i = 0; i < FLOW_INSTANCE_COUNT; i++ )
+	{
+		s_path[i].count = 0;
+		s_path[i].mean = 0;
+		s_path[i].m2 = 0;
+	}
+	s_enabled = enable;
+}
+
+bool zero_enabled( void )
+{
+	return s_enabled;
+}
+
+void zero_reset( void )
+{
+	uint8_t i;
+	for( i = 0; i < FLOW_INSTANCE_COUNT; i++ )
+	{
+		s_path[i].offset = 0;
+		s_path[i].learned = false;
+		s_path[i].capture = false;
+	}
+}
+
+void zero_capture( void )
+{
+	// the pipe is known to be still.  takes effect whether or not learning is enabled.
+	uint8_t i;
+	for( i = 0; i < FLOW_INSTANCE_COUNT; i++ )
+	{
+		s_path[i].count = 0;
+		s_path[i].mean = 0;
+		s_path[i].m2 = 0;
+		s_path[i].capture = true;
+	}
+}
+
+void zero_set_offset( uint8_t path, fixed_t offset )
+{
+	// a zero offset (the default) leaves the path free to seed from the next quiet window
+	if( path < FLOW_INSTANCE_COUNT )
+	{
+		s_path[path].offset = offset;
+		s_path[path].learned = offset != 0;
+	}
+}
+
+fixed_t zero_get_offset( uint8_t path )
+{
+	return path < FLOW_INSTANCE_COUNT ? s_path[path].offset : 0;
+}
+
+void zero_set_limits( float_t band, float_t noise, float_t seed )
+{
+	// seconds
+	s_band = band / FIXED_TO_SECONDS;
+	s_noise = noise / FIXED_TO_SECONDS;
+	s_seed = seed / FIXED_TO_SECONDS;
+}
+
+void zero_get_limits( float_t *p_band, float_t *p_noise, float_t *p_seed )
+{
+	*p_band = s_band * FIXED_TO_SECONDS;
+	*p_noise = s_noise * FIXED_TO_SECONDS;
+	*p_seed = s_seed * FIXED_TO_SECONDS;
+}